@@ -1,7 +1,7 @@
 #include "ascii_render.hpp"
-#include <iostream>
-#include <sstream>
-#include <stdexcept>
+#include "thread_affinity.hpp"
+#include "thread_pool.hpp"
+#include "trace.hpp"
 #include <cstdio>
 #include <cstring>
 #include <vector>
@@ -12,105 +12,125 @@
 #include <functional>
 #include <condition_variable>
 #include <atomic>
+#include <mutex>
 #include <numeric>
 #include <array>
 #include <algorithm>
+#include <cmath>
+#include <memory>
 
 
 
 static const char* LUT = " `.,:;_-~\"><|!/)(^?}{][*=clsji+o2r7fC1xekJutFyVnLzS53TmG4PhaqEwYvZ96bdpg0OUAXNDQRKHM8B&%$W#@";
 
-class ThreadPool {
-public:
-    ThreadPool(size_t num_threads) : stop_flag(false) {
-        for (size_t i = 0; i < num_threads; ++i) {
-            workers.emplace_back([this] {
-                for (;;) {
-                    std::function<void()> task;
-                    {
-                        std::unique_lock<std::mutex> lock(this->mtx);
-                        cv_task.wait(lock, [this] {
-                            return this->stop_flag || !this->tasks.empty();
-                        });
-                        if (this->stop_flag && this->tasks.empty()) return;
-                        task = std::move(this->tasks.front());
-                        this->tasks.pop();
-                    }
-                    task();
-                }
-            });
-        }
-    }
-    ~ThreadPool() {
-        {
-            std::unique_lock<std::mutex> lock(mtx);
-            stop_flag = true;
-        }
-        cv_task.notify_all();
-        for (auto &t : workers) t.join();
-    }
-    void enqueue(std::function<void()> f) {
-        {
-            std::unique_lock<std::mutex> lock(mtx);
-            tasks.push(std::move(f));
-        }
-        cv_task.notify_one();
-    }
-    void wait_all() {
-        std::unique_lock<std::mutex> lock(wait_mtx);
-        cv_wait.wait(lock, [this] { return pending_jobs == 0; });
-    }
-    void job_started() {
-        pending_jobs++;
-    }
-    void job_finished() {
-        {
-            std::unique_lock<std::mutex> lock(wait_mtx);
-            pending_jobs--;
+// --- palettes ---
+// Both palettes share the color indices: 0..215 a 6x6x6 cube in r*36 + g*6 + b
+// order (215 is white in both), 216..239 the xterm gray ramp.
+static constexpr int CUBE_LEVELS = 6;
+static constexpr int CUBE_COUNT  = CUBE_LEVELS*CUBE_LEVELS*CUBE_LEVELS;
+static constexpr int PALETTE_MAX = CUBE_COUNT + 24;
+
+static_assert(PALETTE_MAX == ascii_render::ColorTable::MAX_COLORS, "palette size");
+
+// pixel -> color index table, 5 bits per channel: 32 KiB, stays in cache
+static constexpr int LUT_BITS = ascii_render::ColorTable::LUT_BITS;
+static constexpr int LUT_SIZE = 1 << (3 * LUT_BITS);
+
+// OKLab: euclidean distance there follows perceived color difference far
+// better than in sRGB, most of all in dark tones
+struct Lab { float L, a, b; };
+
+static float srgb_to_linear(unsigned v) {
+    float c = v / 255.0f;
+    return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+// from linear RGB
+static Lab oklab(float r, float g, float b) {
+    float l = std::cbrt(0.4122214708f * r + 0.5363325363f * g + 0.0514459929f * b);
+    float m = std::cbrt(0.2119034982f * r + 0.6806995451f * g + 0.1073969566f * b);
+    float s = std::cbrt(0.0883024619f * r + 0.2817188376f * g + 0.6299787005f * b);
+    return Lab{0.2104542553f * l + 0.7936177850f * m - 0.0040720468f * s,
+               1.9779984951f * l - 2.4285922050f * m + 0.4505937099f * s,
+               0.0259040371f * l + 0.7827717662f * m - 0.8086757660f * s};
+}
+
+ascii_render::ColorTable::ColorTable(Palette palette) : which(palette) {
+    const bool xterm = palette == Palette::Xterm256;
+    static const int XTERM_LEVELS[CUBE_LEVELS] = {0, 95, 135, 175, 215, 255};
+    auto level = [&](int i) { return xterm ? XTERM_LEVELS[i] : (i * 255) / (CUBE_LEVELS - 1); };
+
+    count = xterm ? PALETTE_MAX : CUBE_COUNT;
+    std::array<std::array<int, 3>, PALETTE_MAX> rgb{};
+    for (int idx = 0; idx < count; ++idx) {
+        int R, G, B;
+        if (idx < CUBE_COUNT) {
+            R = level(idx / 36); G = level(idx / 6 % 6); B = level(idx % 6);
+        } else {
+            R = G = B = 8 + 10 * (idx - CUBE_COUNT);
         }
-        cv_wait.notify_all();
+        rgb[idx] = {R, G, B};
+        // "\x1b[38;5;Nm" (xterm color 16 + idx) or "\x1b[38;2;R;G;Bm"
+        int n = xterm ? std::snprintf(sgr[idx].data(), sgr[idx].size(), "\x1b[38;5;%dm", 16 + idx)
+                      : std::snprintf(sgr[idx].data(), sgr[idx].size(), "\x1b[38;2;%d;%d;%dm", R, G, B);
+        sgr_len[idx] = static_cast<uint8_t>(n);
     }
-private:
-    std::vector<std::thread> workers;
-    std::queue<std::function<void()>> tasks;
-    std::mutex mtx;
-    std::condition_variable cv_task;
-    std::atomic<bool> stop_flag;
-
-    std::mutex wait_mtx;
-    std::condition_variable cv_wait;
-    std::atomic<int> pending_jobs{0};
-};
-
-static constexpr int Q_LEVELS = 6;
-static constexpr int Q_COUNT  = Q_LEVELS*Q_LEVELS*Q_LEVELS;
-
-static std::array<std::array<char, 20>, Q_COUNT> g_ansi; 
-static std::array<uint8_t, Q_COUNT>              g_ansi_len{};
-
-static inline void ansi_init_once() {
-    static bool inited = false;
-    if (inited) return;
-
-    auto lvl = [](int i){ return (i * 255) / (Q_LEVELS - 1); }; // i ∈ [0..5]
-    for (int r = 0; r < Q_LEVELS; ++r) {
-        for (int g = 0; g < Q_LEVELS; ++g) {
-            for (int b = 0; b < Q_LEVELS; ++b) {
-                int idx = (r * Q_LEVELS + g) * Q_LEVELS + b;
-                int R = lvl(r), G = lvl(g), B = lvl(b);
-                char* p = g_ansi[idx].data();
-                // "\x1b[38;2;R;G;Bm"
-                std::memcpy(p, "\x1b[38;2;", 7); p += 7;
-                p += std::sprintf(p, "%d;%d;%dm", R, G, B);
-                g_ansi_len[idx] = static_cast<uint8_t>(p - g_ansi[idx].data());
+
+    // entries sorted by lightness: the nearest-entry search starts at the
+    // cell's own L and stops once the L difference alone is too far
+    struct Entry { Lab lab; int index; };
+    std::vector<Entry> entries(count);
+    for (int i = 0; i < count; ++i)
+        entries[i] = Entry{oklab(srgb_to_linear(rgb[i][0]), srgb_to_linear(rgb[i][1]), srgb_to_linear(rgb[i][2])), i};
+    std::sort(entries.begin(), entries.end(), [](const Entry& x, const Entry& y) { return x.lab.L < y.lab.L; });
+
+    // every LUT cell holds the entry nearest to the cell's center
+    const int bins = 1 << LUT_BITS, shift = 8 - LUT_BITS;
+    std::vector<float> center(bins);
+    for (int i = 0; i < bins; ++i) center[i] = srgb_to_linear((unsigned)((i << shift) + (1 << (shift - 1))));
+    lut.resize(LUT_SIZE);
+    int best = 0; // position in entries; the neighbouring cell's answer is a close first guess
+    for (int r = 0; r < bins; ++r) {
+        for (int g = 0; g < bins; ++g) {
+            for (int b = 0; b < bins; ++b) {
+                Lab c = oklab(center[r], center[g], center[b]);
+                float best_d = 1e9f;
+                auto consider = [&](int i) {
+                    const Lab& e = entries[i].lab;
+                    float dL = c.L - e.L, da = c.a - e.a, db = c.b - e.b;
+                    float d = dL * dL + da * da + db * db;
+                    if (d < best_d) { best_d = d; best = i; }
+                };
+                consider(best);
+                int mid = (int)(std::lower_bound(entries.begin(), entries.end(), c.L,
+                                                 [](const Entry& e, float L) { return e.lab.L < L; }) - entries.begin());
+                for (int i = mid; i < count; ++i) {
+                    float dL = entries[i].lab.L - c.L;
+                    if (dL * dL >= best_d) break;
+                    consider(i);
+                }
+                for (int i = mid - 1; i >= 0; --i) {
+                    float dL = c.L - entries[i].lab.L;
+                    if (dL * dL >= best_d) break;
+                    consider(i);
+                }
+                lut[((size_t)r << (2 * LUT_BITS)) | (g << LUT_BITS) | b] = (uint8_t)entries[best].index;
             }
         }
     }
-    inited = true;
 }
 
-static inline int qidx(unsigned v) {
-    return (int)((v * Q_LEVELS) >> 8);
+std::string_view ascii_render::ColorTable::sequence(uint16_t color) const {
+    if (color == DEFAULT_COLOR) return "\x1b[39m";
+    return std::string_view(sgr[color].data(), sgr_len[color]);
+}
+
+static std::atomic<ascii_render::Palette> g_palette{ascii_render::Palette::Cube216};
+
+// lut from ColorTable::lookup(); a local pointer stays in a register in the pixel loops
+static inline uint16_t palette_index(const uint8_t* lut, unsigned r, unsigned g, unsigned b) {
+    const int shift = 8 - LUT_BITS;
+    return lut[((r >> shift) << (2 * LUT_BITS)) | ((g >> shift) << LUT_BITS) | (b >> shift)];
 }
 
 static inline int digits_u8(unsigned v){ return (v>=100)?3: (v>=10)?2:1; }
@@ -152,277 +172,350 @@ static inline void append_ansi_rgb(char*& ptr, unsigned r, unsigned g, unsigned
 
 namespace ascii_render {
 
-    static std::vector<std::string> prev_lines;
-
-    size_t render_frame(const std::string& frame) {
-        std::vector<std::string> lines;
-        size_t pos = 0, prev = 0;
-        while ((pos = frame.find('\n', prev)) != std::string::npos) {
-            lines.push_back(frame.substr(prev, pos - prev));
-            prev = pos + 1;
-        }
-        if (prev < frame.size()) {
-            lines.push_back(frame.substr(prev));
-        }
-
-        std::cout << "\x1b[H";
+    ThreadPool& shared_pool() {
+        // intentionally never destroyed: workers may still be parked at process exit
+        static ThreadPool* pool = new ThreadPool(std::max(1u, std::thread::hardware_concurrency()),
+                                                 [] {
+                                                     apply_thread_role(ThreadRole::Encode);
+                                                     trace_thread_name("encode worker");
+                                                 });
+        return *pool;
+    }
 
-        std::cout << "\x1b[H\x1b[48;2;0;0;0m"; 
+    // tile/frame encoders may hit this from several workers at once
+    const ColorTable& active_colors() {
+        static std::unique_ptr<ColorTable> tables[2];
+        static std::once_flag once[2];
+        Palette which = g_palette.load(std::memory_order_relaxed);
+        int k = which == Palette::Xterm256 ? 1 : 0;
+        std::call_once(once[k], [&] { tables[k] = std::make_unique<ColorTable>(which); });
+        return *tables[k];
+    }
 
-        size_t updated_lines = 0;
-        for (size_t i = 0; i < lines.size(); ++i) {
-            if (i >= prev_lines.size() || lines[i] != prev_lines[i]) {
-                std::cout << "\x1b[" << (i + 1) << ";1H" << lines[i];
-                ++updated_lines;
-            }
-        }
-        std::cout.flush();
-        prev_lines = lines;
-        return updated_lines;
+    void set_palette(Palette palette) {
+        g_palette.store(palette);
+        active_colors(); // build the lookup table now, not on the first frame
     }
 
-    std::string frame_to_ascii_mono(
-        const cv::Mat& frame,
-        bool is_paused,
-        double progress,
-        double current_time,
-        double total_time,
-        int volume
-    ) {
-        if (frame.channels() != 3 && frame.channels() != 4) {
-            throw std::runtime_error("Expected 3- or 4-channel BGR(A) image");
-        }
+    Palette active_palette() {
+        return g_palette.load();
+    }
 
-        int height = frame.rows;
-        int width = frame.cols;
+    std::string_view color_sequence(uint16_t color) {
+        if (color == DEFAULT_COLOR) return "\x1b[39m";
+        return active_colors().sequence(color);
+    }
 
-        cv::Mat gray;
-        if (frame.channels() == 3)
-            cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
-        else 
-            cv::cvtColor(frame, gray, cv::COLOR_BGRA2GRAY);
+    void CellGrid::resize(int w, int h) {
+        width = std::max(0, w);
+        height = std::max(0, h);
+        glyphs.assign((size_t)width * height, ' ');
+        colors.assign((size_t)width * height, DEFAULT_COLOR);
+    }
 
-        std::ostringstream oss;
+    void CellGrid::fill(char ch, uint16_t color) {
+        std::fill(glyphs.begin(), glyphs.end(), ch);
+        std::fill(colors.begin(), colors.end(), color);
+    }
 
-        auto gray_to_ascii = [](uchar value) -> char {
-            size_t len = strlen(LUT);
-            int index = static_cast<int>((value * (len - 1)) / 255);
-            return LUT[index];
-        };
+    static inline uint8_t luma(unsigned r, unsigned g, unsigned b) {
+        return (uint8_t)((r*77u + g*150u + b*29u) >> 8);
+    }
 
-        for (int y = 0; y < gray.rows; ++y) {
-            for (int x = 0; x < gray.cols; ++x) {
-                uchar pixel = gray.at<uchar>(y, x);
-                oss << gray_to_ascii(pixel);
+    // rows [y0, y1) of a grid frame into cells, luminance ramp only; lut nullptr: no color
+    static void encode_rows_luma(const cv::Mat& frame, int y0, int y1, const uint8_t* lut, CellGrid& out) {
+        const int W = frame.cols;
+        const size_t LUTn = std::strlen(LUT);
+        for (int y = y0; y < y1; ++y) {
+            const unsigned char* row = frame.ptr<unsigned char>(y);
+            char* glyph = out.glyph_row(y);
+            uint16_t* color = out.color_row(y);
+            for (int x = 0; x < W; ++x) {
+                unsigned b = row[x*3+0], g = row[x*3+1], r = row[x*3+2];
+                glyph[x] = LUT[(luma(r, g, b) * (LUTn - 1)) / 255];
+                color[x] = lut ? palette_index(lut, r, g, b) : DEFAULT_COLOR;
             }
-            oss << "\n";
         }
+    }
 
-        auto format_time = [](double seconds) -> std::string {
-            int total_sec = static_cast<int>(seconds);
-            int m = total_sec / 60;
-            int s = total_sec % 60;
-            char buffer[6];
-            snprintf(buffer, sizeof(buffer), "%02d:%02d", m, s);
-            return std::string(buffer);
-        };
-
-        std::string current_time_str = format_time(current_time);
-        std::string total_time_str = format_time(total_time);
-        std::string time_str = " " + current_time_str + " / " + total_time_str;
-
-        std::string status = is_paused ? "||" : "|>";
-
-        int bar_width = width;
-        if (bar_width < 10) bar_width = 10;
+    // |gx| + |gy| above this (of at most 2040) draws a directional glyph
+    static constexpr int EDGE_THRESHOLD = 192;
 
-        if (progress < 0.0) progress = 0.0;
-        if (progress > 1.0) progress = 1.0;
+    // 3x3 Sobel over three gray rows; borders repeat the outermost column
+    static void sobel_row(const uint8_t* top, const uint8_t* mid, const uint8_t* bot, int W,
+                          int16_t* gx, int16_t* gy) {
+        auto scalar = [&](int x) {
+            int xl = std::max(0, x - 1), xr = std::min(W - 1, x + 1);
+            gx[x] = (int16_t)((top[xr] - top[xl]) + 2 * (mid[xr] - mid[xl]) + (bot[xr] - bot[xl]));
+            gy[x] = (int16_t)((bot[xl] + 2 * bot[x] + bot[xr]) - (top[xl] + 2 * top[x] + top[xr]));
+        };
+        if (W < 1) return;
+        scalar(0);
+        int x = 1;
+#if defined(__SSE2__) || defined(_M_X64)
+        // 8 cells per step in 16-bit lanes; reads bytes x-1 .. x+8
+        const __m128i z = _mm_setzero_si128();
+        auto ld = [&](const uint8_t* p) { return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)p), z); };
+        for (; x + 9 <= W; x += 8) {
+            __m128i a0 = ld(top + x - 1), a1 = ld(top + x), a2 = ld(top + x + 1);
+            __m128i b0 = ld(mid + x - 1), b2 = ld(mid + x + 1);
+            __m128i c0 = ld(bot + x - 1), c1 = ld(bot + x), c2 = ld(bot + x + 1);
+            __m128i dx = _mm_add_epi16(_mm_add_epi16(_mm_sub_epi16(a2, a0), _mm_sub_epi16(c2, c0)),
+                                       _mm_slli_epi16(_mm_sub_epi16(b2, b0), 1));
+            __m128i dy = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(c0, c2), _mm_slli_epi16(c1, 1)),
+                                       _mm_add_epi16(_mm_add_epi16(a0, a2), _mm_slli_epi16(a1, 1)));
+            _mm_storeu_si128((__m128i*)(gx + x), dx);
+            _mm_storeu_si128((__m128i*)(gy + x), dy);
+        }
+#endif
+        for (; x < W; ++x) scalar(x);
+    }
 
-        int filled_length = static_cast<int>(progress * bar_width);
-        std::string progress_bar(filled_length, '#');
-        progress_bar += std::string(bar_width - filled_length, '-');
+    // directional glyph for a strong gradient; the edge runs across the gradient
+    static inline char edge_glyph(int gx, int gy) {
+        int ax = std::abs(gx), ay = std::abs(gy);
+        if (ax > 2 * ay) return '|';
+        if (ay > 2 * ax) return gy > 0 ? '_' : '-'; // '_' on the top of a bright shape, '-' under it
+        return ((gx > 0) == (gy > 0)) ? '/' : '\\';
+    }
 
-        oss << progress_bar << "\n";
+    // rows [y0, y1) of a grid frame into cells, directional glyphs on strong edges
+    static void encode_rows_edges(const cv::Mat& frame, int y0, int y1, const uint8_t* lut, CellGrid& out) {
+        const int W = frame.cols, H = frame.rows;
+        const size_t LUTn = std::strlen(LUT);
 
-        std::string volume_str = "Vol: " + std::to_string(volume) + "% ";
-        int total_len = width;
-        int time_len = (int)time_str.length();
-        int status_len = 2;
-        int volume_len = (int)volume_str.length();
-        int status_start_pos = total_len / 2 - status_len / 2;
+        // gray rows y-1, y, y+1 in a ring, gradients of the current row; per worker, reused
+        thread_local std::vector<uint8_t> ring;
+        thread_local std::vector<int16_t> gx, gy;
+        ring.resize((size_t)W * 3);
+        gx.resize(W);
+        gy.resize(W);
+
+        auto slot = [&](int y) { return ring.data() + (size_t)((y + 3) % 3) * W; }; // y >= -1
+        auto load_gray = [&](int y) {
+            const unsigned char* row = frame.ptr<unsigned char>(std::clamp(y, 0, H - 1));
+            uint8_t* g = slot(y);
+            for (int x = 0; x < W; ++x) g[x] = luma(row[x*3+2], row[x*3+1], row[x*3+0]);
+        };
 
-        std::string line(total_len, ' ');
-        for (int i = 0; i < time_len && i < total_len; ++i) {
-            line[i] = time_str[i];
-        }
-        for (int i = 0; i < volume_len && (total_len - volume_len + i) < total_len; ++i) {
-            line[total_len - volume_len + i] = volume_str[i];
+        load_gray(y0 - 1);
+        load_gray(y0);
+        for (int y = y0; y < y1; ++y) {
+            load_gray(y + 1);
+            const uint8_t* mid = slot(y);
+            sobel_row(slot(y - 1), mid, slot(y + 1), W, gx.data(), gy.data());
+
+            const unsigned char* row = frame.ptr<unsigned char>(y);
+            char* glyph = out.glyph_row(y);
+            uint16_t* color = out.color_row(y);
+            for (int x = 0; x < W; ++x) {
+                int dx = gx[x], dy = gy[x];
+                glyph[x] = (std::abs(dx) + std::abs(dy) > EDGE_THRESHOLD)
+                    ? edge_glyph(dx, dy)
+                    : LUT[(mid[x] * (LUTn - 1)) / 255];
+                color[x] = lut ? palette_index(lut, row[x*3+2], row[x*3+1], row[x*3+0]) : DEFAULT_COLOR;
+            }
         }
-        if (status_start_pos >= 0 && status_start_pos + status_len <= total_len)
-            line.replace(status_start_pos, status_len, status);
-        oss << line << "\n";
+    }
 
-        return oss.str();
+    static void encode_rows(const cv::Mat& frame, int y0, int y1, const uint8_t* lut, GlyphMode mode, CellGrid& out) {
+        TraceSpan span("encode rows", y1 - y0);
+        if (mode == GlyphMode::Edges) encode_rows_edges(frame, y0, y1, lut, out);
+        else encode_rows_luma(frame, y0, y1, lut, out);
     }
 
-    std::string frame_to_ascii_color(
-        const cv::Mat& frame,   // CV_8UC3, continuous
-        bool is_paused,
-        double progress,
-        double current_time,
-        double total_time,
-        int volume,
-        int num_threads
-    ){
-        ansi_init_once();
-
-        static ThreadPool* pool = nullptr;
-        static int pool_threads = 0;
-        if (!pool) { pool = new ThreadPool(std::max(1, num_threads)); pool_threads = std::max(1, num_threads); }
-        const int T = std::max(1, pool_threads);
+    static const uint8_t* lookup_of(const ColorTable* colors) {
+        return colors ? colors->lookup() : nullptr;
+    }
+
+    void frame_to_cells(const cv::Mat& frame, bool rgb, CellGrid& out, int num_threads, GlyphMode mode) {
+        ThreadPool& pool = shared_pool();
+        frame_to_cells(frame, rgb ? &active_colors() : nullptr, out, pool,
+                       std::min(num_threads, (int)pool.size()), mode);
+    }
 
+    void frame_to_cells(const cv::Mat& frame, const ColorTable* colors, CellGrid& out,
+                        ThreadPool& pool, int blocks, GlyphMode mode) {
         CV_Assert(frame.type()==CV_8UC3 && frame.isContinuous());
         const int W = frame.cols, H = frame.rows;
+        if (out.width != W || out.height != H) out.resize(W, H);
 
-        const size_t LUTn = std::strlen(LUT);
-
-        const int rows_per = (H + T - 1) / T;
+        const uint8_t* lut = lookup_of(colors);
+        const int T = std::max(1, std::min(blocks, (int)pool.size()));
 
-        std::vector<size_t> blk_len(T, 0);
-        for (int t = 0; t < T; ++t) {
-            int y0 = t * rows_per, y1 = std::min(H, y0 + rows_per);
-            if (y0 >= H) continue;
-            pool->job_started();
-            pool->enqueue([&, t, y0, y1] {
-                size_t L = 0;
-                for (int y = y0; y < y1; ++y) {
-                    const unsigned char* row = frame.ptr<unsigned char>(y);
-                    int last_idx = -1;
-                    for (int x = 0; x < W; ++x) {
-                        unsigned b = row[x*3+0], g = row[x*3+1], r = row[x*3+2];
-                        int idx = (qidx(r) * Q_LEVELS + qidx(g)) * Q_LEVELS + qidx(b);
-                        if (idx != last_idx) { L += g_ansi_len[idx]; last_idx = idx; }
-                        L += 1;
-                    }
-                    L += 1; // '\n'
-                }
-                blk_len[t] = L;
-                pool->job_finished();
-            });
-        }
-        pool->wait_all();
-
-        std::vector<size_t> offset(T, 0);
-        size_t body = 0;
-        for (int t = 0; t < T; ++t) { offset[t] = body; body += blk_len[t]; }
-
-        // sequences we will use
-        const char reset_seq[] = "\x1b[0m";
-        const size_t reset_seq_len = sizeof(reset_seq) - 1; // 4
-
-        // interface color: white foreground + black background (explicit)
-        const std::string iface_color = std::string("\x1b[38;2;255;255;255m") + std::string("\x1b[48;2;0;0;0m");
-        const size_t iface_color_len = iface_color.size();
-
-        const int    barW      = std::max(10, W);
-        const size_t bar_len   = barW + 1;        // + '\n'
-        const size_t status_len= W + 1;           // + '\n'
-
-        // total length: body + initial reset+newline (5) + iface_color + bar_len + iface_color + status_len + final reset
-        const size_t initial_reset_and_nl = reset_seq_len + 1; // "\x1b[0m\n"
-        const size_t final_reset_len = reset_seq_len;
-        const size_t total_len = body + initial_reset_and_nl + iface_color_len + bar_len + iface_color_len + status_len + final_reset_len;
-
-        std::vector<char> buf(total_len);
-        char* base = buf.data();
-
-        // build frame content in parallel (same as before)
-        for (int t = 0; t < T; ++t) {
-            int y0 = t * rows_per, y1 = std::min(H, y0 + rows_per);
-            if (y0 >= H || blk_len[t] == 0) continue;
-            pool->job_started();
-            pool->enqueue([&, t, y0, y1] {
-                char* p = base + offset[t];
-                for (int y = y0; y < y1; ++y) {
-                    const unsigned char* row = frame.ptr<unsigned char>(y);
-                    int last_idx = -1;
-                    for (int x = 0; x < W; ++x) {
-                        unsigned b = row[x*3+0], g = row[x*3+1], r = row[x*3+2];
-
-                        int idx = (qidx(r) * Q_LEVELS + qidx(g)) * Q_LEVELS + qidx(b);
-                        if (idx != last_idx) {
-                            std::memcpy(p, g_ansi[idx].data(), g_ansi_len[idx]);
-                            p += g_ansi_len[idx];
-                            last_idx = idx;
-                        }
-
-                        unsigned gray = (r*77u + g*150u + b*29u) >> 8;
-                        *p++ = LUT[(gray * (LUTn - 1)) / 255];
-                    }
-                    *p++ = '\n';
-                }
-                pool->job_finished();
-            });
+        // a single block runs inline, so callers already on a pool worker don't wait on the pool
+        if (T == 1) {
+            encode_rows(frame, 0, H, lut, mode, out);
+            return;
         }
-        pool->wait_all();
+        const int rows_per = (H + T - 1) / T;
+        parallel_for(pool, (H + rows_per - 1) / rows_per, [&](int t) {
+            int y0 = t * rows_per;
+            encode_rows(frame, y0, std::min(H, y0 + rows_per), lut, mode, out);
+        });
+    }
 
-        // tail after colored body
-        char* tail = base + body;
+    void status_to_cells(const StatusInfo& st, int width, bool rgb, CellGrid& out) {
+        auto put_time5 = [](double sec, char* o){
+            int t = (int)sec; int m = t/60, s = t%60;
+            o[0]='0'+(m/10); o[1]='0'+(m%10);
+            o[2]=':'; o[3]='0'+(s/10); o[4]='0'+(s%10);
+        };
 
-        // 1) reset any color left by pixels and put newline (preserve original layout)
-        std::memcpy(tail, reset_seq, reset_seq_len);
-        tail += reset_seq_len; // matches original "\x1b[0m\n"
+        const int W = std::max(1, width);
+        const int barW = std::max(10, W);
+        if (out.width != barW || out.height != 2) out.resize(barW, 2);
+        // interface color: white in color mode, the terminal's own otherwise
+        out.fill(' ', rgb ? WHITE : DEFAULT_COLOR);
+
+        // row 0: progress bar
+        int filled = static_cast<int>(std::clamp(st.progress, 0.0, 1.0) * barW);
+        char* bar = out.glyph_row(0);
+        std::memset(bar, '#', filled);
+        std::memset(bar + filled, '-', barW - filled);
+
+        // row 1: " mm:ss / mm:ss", play state centered, volume right-aligned
+        char* line = out.glyph_row(1);
+        char t[16] = " ";
+        put_time5(st.current_time, t + 1);
+        std::memcpy(t + 6, " / ", 3);
+        put_time5(st.total_time, t + 9);
+        for (int i = 0; i < 14 && i < W; ++i) line[i] = t[i];
+
+        std::string vol = "Vol: " + std::to_string(st.volume) + "% ";
+        if ((int)vol.size() <= W) {
+            std::memcpy(&line[W - (int)vol.size()], vol.data(), vol.size());
+        }
 
-        // 2) progress bar, force interface color before it
-        std::memcpy(tail, iface_color.data(), iface_color_len); tail += iface_color_len;
+        const char* status = st.is_paused ? "||" : "|>";
+        int spos = W/2 - 1;
+        if (spos >= 0 && spos + 2 <= W) { line[spos]=status[0]; line[spos+1]=status[1]; }
 
-        double prog = std::clamp(progress, 0.0, 1.0);
-        int filled = static_cast<int>(prog * barW);
-        if (filled > 0) {
-            std::memset(tail, '#', filled);
-            tail += filled;
-        }
-        if (barW - filled > 0) {
-            std::memset(tail, '-', barW - filled);
-            tail += (barW - filled);
+        if (st.speed != 1.0) {
+            char rate[16];
+            int n = std::snprintf(rate, sizeof(rate), "%gx", st.speed);
+            if (spos >= 0 && spos + 3 + n <= W) std::memcpy(&line[spos + 3], rate, n);
         }
-        *tail++ = '\n';
+    }
 
-        // 3) status line, ensure interface color is active (we already set it before bar, but set again to be explicit)
-        std::memcpy(tail, iface_color.data(), iface_color_len); tail += iface_color_len;
+    // --- static content detection ---
+
+    // 64-bit multiplicative hash over 8-byte words; equal rows of a grid frame encode to equal cells
+    static uint64_t hash_row(const unsigned char* p, size_t n) {
+        uint64_t h = 0x9E3779B97F4A7C15ull ^ n;
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            uint64_t w;
+            std::memcpy(&w, p + i, 8);
+            h = (h ^ w) * 0x100000001B3ull;
+            h ^= h >> 29;
+        }
+        for (; i < n; ++i) h = (h ^ p[i]) * 0x100000001B3ull;
+        return h ^ (h >> 32);
+    }
 
-        auto put_time5 = [](double sec, char* out){
-            int t = (int)sec; int m = t/60, s = t%60;
-            out[0]='0'+(m/10); out[1]='0'+(m%10);
-            out[2]=':'; out[3]='0'+(s/10); out[4]='0'+(s%10);
-        };
-        std::vector<char> line(W, ' ');
-        char t1[5], t2[5]; put_time5(current_time,t1); put_time5(total_time,t2);
+    void FrameCache::invalidate() {
+        hashes.clear();
+        row_ok.clear();
+        size = cv::Size();
+    }
 
-        // " mm:ss / mm:ss"
-        size_t pos = 0;
-        line[pos++] = ' ';
-        std::memcpy(&line[pos], t1, 5); pos += 5;
-        std::memcpy(&line[pos], " / ", 3); pos += 3;
-        std::memcpy(&line[pos], t2, 5); pos += 5;
+    size_t FrameCache::update_signature(const cv::Mat& frame, bool rgb, GlyphMode mode) {
+        CV_Assert(frame.type()==CV_8UC3 && frame.isContinuous());
+        const int H = frame.rows;
+        if (frame.size() != size || rgb != last_rgb || mode != last_mode || (int)hashes.size() != H) {
+            size = frame.size();
+            last_rgb = rgb;
+            last_mode = mode;
+            hashes.assign(H, 0);
+            row_ok.assign(H, 0);
+        }
 
-        std::string vol = "Vol: " + std::to_string(volume) + "% ";
-        if ((int)vol.size() <= W) {
-            std::memcpy(&line[W - (int)vol.size()], vol.data(), vol.size());
+        changed.clear();
+        const size_t row_bytes = (size_t)frame.cols * 3;
+        for (int y = 0; y < H; ++y) {
+            uint64_t h = hash_row(frame.ptr<unsigned char>(y), row_bytes);
+            if (!row_ok[y] || h != hashes[y]) {
+                hashes[y] = h;
+                changed.push_back(y);
+            }
+        }
+        if (mode == GlyphMode::Edges && !changed.empty()) {
+            // edge glyphs look one row up and down: neighbours of a changed row re-encode too
+            near_changed.assign(H, 0);
+            for (int y : changed) {
+                for (int n = std::max(0, y - 1); n <= std::min(H - 1, y + 1); ++n) near_changed[n] = 1;
+            }
+            changed.clear();
+            for (int y = 0; y < H; ++y) {
+                if (near_changed[y]) changed.push_back(y);
+            }
         }
+        return changed.size();
+    }
 
-        const char* status = is_paused ? "||" : "|>";
-        int spos = W/2 - 1;
-        if (spos >= 0 && spos + 2 <= W) { line[spos]=status[0]; line[spos+1]=status[1]; }
+    bool FrameCache::repeat(const cv::Mat& frame, bool rgb, GlyphMode mode) {
+        ++counters.frames;
+        update_signature(frame, rgb, mode);
+        if (changed.empty()) {
+            ++counters.frames_skipped;
+            counters.rows_reused += frame.rows;
+            return true;
+        }
+        // the caller encodes this frame itself, so keep hashes but not the cells
+        counters.rows_encoded += frame.rows;
+        for (int y : changed) row_ok[y] = 1;
+        cells_valid = false;
+        return false;
+    }
 
-        std::memcpy(tail, line.data(), W); tail += W;
-        *tail++ = '\n';
+    bool FrameCache::encode(const cv::Mat& frame, bool rgb, int num_threads, GlyphMode mode) {
+        ThreadPool& pool = shared_pool();
+        return encode(frame, rgb ? &active_colors() : nullptr, pool, std::min(num_threads, (int)pool.size()), mode);
+    }
 
-        // 4) final reset so terminal returns to normal (prevents leakage to terminal)
-        std::memcpy(tail, reset_seq, reset_seq_len); tail += reset_seq_len;
+    bool FrameCache::encode(const cv::Mat& frame, const ColorTable* colors, ThreadPool& pool, int blocks,
+                            GlyphMode mode) {
+        const bool rgb = colors != nullptr;
+        const uint8_t* lut = lookup_of(colors);
+        ++counters.frames;
+        if (!cells_valid) {
+            std::fill(row_ok.begin(), row_ok.end(), 0);
+            cells_valid = true;
+        }
+        update_signature(frame, rgb, mode);
+        if (grid.width != frame.cols || grid.height != frame.rows) grid.resize(frame.cols, frame.rows);
 
-        // sanity: tail - base should equal total_len (optional in debug)
-        return std::string(buf.data(), tail - buf.data());
+        if (changed.empty()) {
+            ++counters.frames_skipped;
+            counters.rows_reused += frame.rows;
+            return false;
+        }
+        counters.rows_reused += frame.rows - changed.size();
+        counters.rows_encoded += changed.size();
+
+        // only the changed rows are encoded; spread them over the pool when there are many
+        const int T = std::max(1, std::min(blocks, (int)pool.size()));
+        const size_t n = changed.size();
+        // consecutive changed rows go through the encoder as one block
+        auto encode_changed = [&](size_t i0, size_t i1) {
+            while (i0 < i1) {
+                size_t j = i0 + 1;
+                while (j < i1 && changed[j] == changed[j - 1] + 1) ++j;
+                encode_rows(frame, changed[i0], changed[j - 1] + 1, lut, mode, grid);
+                i0 = j;
+            }
+        };
+        if (T == 1 || n < 8) {
+            encode_changed(0, n);
+        } else {
+            const size_t per = (n + T - 1) / T;
+            parallel_for(pool, (int)((n + per - 1) / per), [&](int t) {
+                size_t i0 = (size_t)t * per;
+                encode_changed(i0, std::min(n, i0 + per));
+            });
+        }
+        for (int y : changed) row_ok[y] = 1;
+        return true;
     }
 }
@@ -1,28 +1,138 @@
 #pragma once
 #include <opencv2/opencv.hpp>
+#include <array>
 #include <string>
+#include <string_view>
 #include <vector>
+#include <cstdint>
+
+class ThreadPool;
 
 namespace ascii_render {
 
-    size_t render_frame(const std::string& frame);
-
-    std::string frame_to_ascii_mono(
-        const cv::Mat& frame,
-        bool is_paused,
-        double progress,
-        double current_time,
-        double total_time,
-        int volume
-    );
-
-    std::string frame_to_ascii_color(
-        const cv::Mat& frame,
-        bool is_paused,
-        double progress,
-        double current_time,
-        double total_time,
-        int volume,
-        int num_threads
-    );
+    // worker pool shared by every encoder in the process, one worker per
+    // core; callers pick how many blocks of their own to split work into
+    ThreadPool& shared_pool();
+
+    // cell colors are palette indices; DEFAULT_COLOR leaves the terminal's own foreground
+    constexpr uint16_t DEFAULT_COLOR = 0xFFFF;
+    constexpr uint16_t WHITE = 215; // interface color, (255,255,255) in either palette
+
+    // the colors cells can take: a 6x6x6 cube written as 24-bit color, or the
+    // xterm-256 cube and gray ramp written as 256-color indices (240 colors,
+    // the 16 theme-dependent system colors are left out). Pixels are mapped
+    // through a 32x32x32 table of nearest colors in OKLab.
+    enum class Palette { Cube216, Xterm256 };
+
+    // A palette's SGR codes and its pixel -> color table. Building one takes a
+    // few ms; after that it is read-only and any number of threads share it.
+    class ColorTable {
+    public:
+        static constexpr int LUT_BITS = 5;     // per channel: 32x32x32 entries
+        static constexpr int MAX_COLORS = 240;
+
+        explicit ColorTable(Palette palette);
+
+        Palette palette() const { return which; }
+        std::string_view sequence(uint16_t color) const; // foreground SGR, DEFAULT_COLOR included
+        const uint8_t* lookup() const { return lut.data(); } // index (r>>3)<<10 | (g>>3)<<5 | b>>3
+
+    private:
+        Palette which;
+        int count = 0;
+        std::array<std::array<char, 20>, MAX_COLORS> sgr{};
+        std::array<uint8_t, MAX_COLORS> sgr_len{};
+        std::vector<uint8_t> lut;
+    };
+
+    // process-wide; call before frames are encoded, not while they are
+    void set_palette(Palette palette);
+    Palette active_palette();
+    const ColorTable& active_colors(); // the table behind color_sequence() and the rgb overloads
+
+    // foreground SGR sequence for a cell color
+    std::string_view color_sequence(uint16_t color);
+
+    // a block of terminal cells: one glyph and one color per cell, row-major
+    struct CellGrid {
+        int width = 0;
+        int height = 0;
+        std::vector<char> glyphs;
+        std::vector<uint16_t> colors;
+
+        void resize(int w, int h);
+        void fill(char ch, uint16_t color);
+        char* glyph_row(int y) { return glyphs.data() + (size_t)y * width; }
+        uint16_t* color_row(int y) { return colors.data() + (size_t)y * width; }
+        const char* glyph_row(int y) const { return glyphs.data() + (size_t)y * width; }
+        const uint16_t* color_row(int y) const { return colors.data() + (size_t)y * width; }
+    };
+
+    // how glyphs are picked: the luminance ramp only, or directional glyphs
+    // (/ \ | - _) on cells with a strong Sobel gradient and the ramp elsewhere
+    enum class GlyphMode { Luminance, Edges };
+
+    // glyph (+ palette color when rgb) for every pixel of a CV_8UC3 grid
+    // frame; rows are split into blocks over the shared pool
+    void frame_to_cells(const cv::Mat& frame, bool rgb, CellGrid& out, int num_threads,
+                        GlyphMode mode = GlyphMode::Luminance);
+
+    // the same with nothing process-wide: rows go in `blocks` tasks to pool
+    // (1 runs inline on the caller), colors nullptr encodes glyphs only
+    void frame_to_cells(const cv::Mat& frame, const ColorTable* colors, CellGrid& out,
+                        ThreadPool& pool, int blocks, GlyphMode mode = GlyphMode::Luminance);
+
+    // what the progress bar and status line show
+    struct StatusInfo {
+        bool is_paused;
+        double progress;
+        double current_time;
+        double total_time;
+        int volume;
+        double speed = 1.0; // playback rate, shown next to the play state when not 1x
+    };
+
+    // progress bar + status line as a 2-row grid, max(10, width) wide
+    void status_to_cells(const StatusInfo& st, int width, bool rgb, CellGrid& out);
+
+    // Skips encode work on static content. Keeps a hash of every row of the
+    // last grid frame: only rows whose hash changed are re-encoded into the
+    // cell grid, and a frame identical to the previous one is not encoded
+    // (or handed to the compositor) at all.
+    class FrameCache {
+    public:
+        struct Stats {
+            uint64_t frames = 0;
+            uint64_t frames_skipped = 0; // identical to the previous frame
+            uint64_t rows_encoded = 0;
+            uint64_t rows_reused = 0;
+        };
+
+        // false when the picture is unchanged; cells then still hold it
+        bool encode(const cv::Mat& frame, bool rgb, int num_threads, GlyphMode mode = GlyphMode::Luminance);
+        bool encode(const cv::Mat& frame, const ColorTable* colors, ThreadPool& pool, int blocks,
+                    GlyphMode mode = GlyphMode::Luminance);
+
+        // signature check only, for callers that encode the frame elsewhere
+        // (frame-parallel mode); true when the frame repeats the previous one
+        bool repeat(const cv::Mat& frame, bool rgb, GlyphMode mode = GlyphMode::Luminance);
+
+        void invalidate();
+        const CellGrid& cells() const { return grid; }
+        const Stats& stats() const { return counters; }
+
+    private:
+        size_t update_signature(const cv::Mat& frame, bool rgb, GlyphMode mode);
+
+        cv::Size size;
+        bool last_rgb = true;
+        GlyphMode last_mode = GlyphMode::Luminance;
+        bool cells_valid = true; // false after repeat(): hashes are current, cells are not
+        std::vector<uint64_t> hashes;
+        std::vector<uint8_t> row_ok;
+        std::vector<int> changed;
+        std::vector<uint8_t> near_changed;
+        CellGrid grid;
+        Stats counters;
+    };
 }
@@ -0,0 +1,172 @@
+#include "bench.hpp"
+#include "ascii_render.hpp"
+#include "compositor.hpp"
+#include "ordered_encoder.hpp"
+#include "renderer.hpp"
+#include "resample.hpp"
+#include "thread_pool.hpp"
+#include <chrono>
+#include <cstdio>
+#include <opencv2/opencv.hpp>
+
+using namespace ascii_render;
+
+namespace {
+
+    const size_t BENCH_FRAMES = 600;
+
+    struct BenchResult {
+        double seconds = 0.0;
+        size_t bytes = 0;
+    };
+
+    double seconds_since(std::chrono::steady_clock::time_point t0) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    }
+
+    RendererOptions bench_options(bool rgb, int threads, GlyphMode mode = GlyphMode::Luminance) {
+        RendererOptions options;
+        options.threads = threads;
+        options.rgb = rgb;
+        options.glyphs = mode;
+        options.palette = active_palette();
+        return options;
+    }
+
+    // the player's screen: a renderer for the video + a status layer
+    struct BenchScreen {
+        Renderer renderer;
+        Layer& status = renderer.screen().add_layer();
+        CellGrid status_cells;
+        std::string out;
+
+        BenchScreen(cv::Size grid, const RendererOptions& options) : renderer(options) {
+            renderer.screen().resize(std::max(10, grid.width), grid.height + 2);
+            status.place(grid.height, 0, std::max(10, grid.width), 2);
+            status_to_cells(StatusInfo{false, 0.5, 30, 60, 50}, grid.width, options.rgb, status_cells);
+            status.assign(status_cells);
+        }
+
+        // composed output is measured, not written
+        size_t present(const CellGrid& cells) {
+            out.clear();
+            renderer.present(cells, out);
+            return out.size();
+        }
+    };
+
+    // encode + present every frame in order
+    BenchResult run_serial(const std::vector<cv::Mat>& frames, const RendererOptions& options) {
+        BenchResult r;
+        BenchScreen screen(frames[0].size(), options);
+        CellGrid cells;
+        auto t0 = std::chrono::steady_clock::now();
+        for (auto& f : frames) {
+            screen.renderer.encode(f, cells);
+            r.bytes += screen.present(cells);
+        }
+        r.seconds = seconds_since(t0);
+        return r;
+    }
+
+    BenchResult run_ordered(const std::vector<cv::Mat>& frames, ThreadPool& pool, bool rgb) {
+        BenchResult r;
+        BenchScreen screen(frames[0].size(), bench_options(rgb, 1));
+        CellGrid cells;
+        const ColorTable* colors = rgb ? &screen.renderer.colors() : nullptr;
+        const OrderedEncoder::EncodeFn encode = [colors, &pool](const cv::Mat& f, CellGrid& out) {
+            frame_to_cells(f, colors, out, pool, 1);
+        };
+        auto t0 = std::chrono::steady_clock::now();
+        {
+            OrderedEncoder encoder(pool, pool.size() * 2);
+            size_t submitted = 0;
+            for (;;) {
+                while (submitted < frames.size() && !encoder.full())
+                    encoder.submit(frames[submitted++], encode);
+                if (!encoder.next(cells)) break;
+                r.bytes += screen.present(cells);
+            }
+        }
+        r.seconds = seconds_since(t0);
+        return r;
+    }
+
+    void print_row(std::ostream& out, const char* mode, const BenchResult& r, size_t frames) {
+        char line[128];
+        std::snprintf(line, sizeof(line), "  %-26s %9.1f %10.3f %12.0f\n", mode,
+                      frames / r.seconds, r.seconds * 1000.0 / frames, (double)r.bytes / frames);
+        out << line;
+    }
+}
+
+int run_bench(const std::vector<std::string>& paths, int width, int threads, std::ostream& out,
+              const RawFormat& raw) {
+    // frame-parallel workers, one per core; row blocks use `threads` on each renderer's own pool
+    ThreadPool& pool = shared_pool();
+
+    for (auto& path : paths) {
+        cv::VideoCapture cap;
+        RawFrameReader reader;
+        bool opened = raw.valid() ? reader.open(path, raw) : cap.open(path);
+        if (!opened) {
+            out << "bench: failed to open " << path << "\n";
+            return 1;
+        }
+        cv::Size source = raw.valid() ? raw.size
+                                      : cv::Size((int)cap.get(cv::CAP_PROP_FRAME_WIDTH), (int)cap.get(cv::CAP_PROP_FRAME_HEIGHT));
+        int height = static_cast<int>((double)source.height / source.width * width * 0.55);
+        cv::Size grid(width, std::max(1, height));
+
+        std::vector<cv::Mat> frames;
+        ResampleCache resampler;
+        cv::Mat frame;
+        auto t0 = std::chrono::steady_clock::now();
+        while (frames.size() < BENCH_FRAMES && (raw.valid() ? reader.read(frame) : cap.read(frame))) {
+            cv::Mat small;
+            resampler.resample(frame, small, grid);
+            frames.push_back(std::move(small));
+        }
+        double decode_s = seconds_since(t0);
+        if (frames.empty()) {
+            out << "bench: no frames decoded from " << path << "\n";
+            return 1;
+        }
+
+        char line[160];
+        std::snprintf(line, sizeof(line), "bench: %s, %zu frames at %dx%d, row blocks %d, frame-parallel workers %d (decode+resample %.1f fps)\n",
+                      path.c_str(), frames.size(), grid.width, grid.height, threads, (int)pool.size(), frames.size() / decode_s);
+        out << line;
+        std::snprintf(line, sizeof(line), "  %-26s %9s %10s %12s\n", "mode", "fps", "ms/frame", "bytes/frame");
+        out << line;
+
+        print_row(out, "mono", run_serial(frames, bench_options(false, 1)), frames.size());
+        print_row(out, "color, 1 thread", run_serial(frames, bench_options(true, 1)), frames.size());
+        print_row(out, "color, row blocks", run_serial(frames, bench_options(true, threads)), frames.size());
+        print_row(out, "color, frame-parallel", run_ordered(frames, pool, true), frames.size());
+        print_row(out, "mono, edges", run_serial(frames, bench_options(false, 1, GlyphMode::Edges)), frames.size());
+        print_row(out, "color, edges", run_serial(frames, bench_options(true, 1, GlyphMode::Edges)), frames.size());
+
+        // edge glyphs keep outlines readable at a smaller grid: same frames at 3/4 size
+        std::vector<cv::Mat> narrow(frames.size());
+        cv::Size narrow_grid(std::max(1, grid.width * 3 / 4), std::max(1, grid.height * 3 / 4));
+        for (size_t i = 0; i < frames.size(); ++i) resampler.resample(frames[i], narrow[i], narrow_grid);
+        print_row(out, "color, edges, 3/4 width", run_serial(narrow, bench_options(true, 1, GlyphMode::Edges)), narrow.size());
+
+        // the other palette on the same frames: xterm-256 codes are shorter than 24-bit ones
+        RendererOptions other = bench_options(true, 1);
+        other.palette = other.palette == Palette::Cube216 ? Palette::Xterm256 : Palette::Cube216;
+        print_row(out, other.palette == Palette::Xterm256 ? "color, xterm-256 palette" : "color, 24-bit palette",
+                  run_serial(frames, other), frames.size());
+
+        // output size by escape forms, color 1 thread
+        RendererOptions absolute = bench_options(true, 1);
+        absolute.escapes.relative_moves = absolute.escapes.rewrite_gaps = false;
+        RendererOptions with_rep = bench_options(true, 1);
+        with_rep.escapes.rep = true;
+        print_row(out, "escapes: absolute moves", run_serial(frames, absolute), frames.size());
+        print_row(out, "escapes: shortest form", run_serial(frames, bench_options(true, 1)), frames.size());
+        print_row(out, "escapes: shortest + REP", run_serial(frames, with_rep), frames.size());
+    }
+    return 0;
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include "raw_input.hpp"
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Headless throughput run: decodes up to a few hundred frames of each video
+// at grid size into memory, then times encode + compositor present of every render mode on
+// those same frames. Nothing is drawn and no audio is started. With a valid
+// raw format the paths are raw BGR24 streams (see RawFrameReader) instead.
+int run_bench(const std::vector<std::string>& paths, int width, int threads, std::ostream& out,
+              const ascii_render::RawFormat& raw = ascii_render::RawFormat());
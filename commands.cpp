@@ -0,0 +1,75 @@
+#include "commands.hpp"
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+namespace ascii_render {
+
+    void CommandQueue::push(Command c) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            queue.push_back(c);
+        }
+        cv.notify_all();
+    }
+
+    bool CommandQueue::pop(Command& c) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (queue.empty()) return false;
+        c = queue.front();
+        queue.pop_front();
+        return true;
+    }
+
+    void CommandQueue::clear() {
+        std::lock_guard<std::mutex> lock(mtx);
+        queue.clear();
+    }
+
+    bool CommandQueue::wait_until(std::chrono::steady_clock::time_point deadline) {
+        std::unique_lock<std::mutex> lock(mtx);
+        return cv.wait_until(lock, deadline, [this] { return !queue.empty(); });
+    }
+
+    void CommandQueue::wait() {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [this] { return !queue.empty(); });
+    }
+
+#ifdef _WIN32
+    InputWakeup::InputWakeup() : event(CreateEventA(nullptr, FALSE, FALSE, nullptr)) {}
+    InputWakeup::~InputWakeup() { if (event) CloseHandle(event); }
+    void InputWakeup::signal() { SetEvent(event); }
+    void InputWakeup::drain() {} // auto-reset event
+#else
+    // self-pipe: the read end is polled next to stdin
+    InputWakeup::InputWakeup() {
+        if (pipe(fds) != 0) {
+            fds[0] = fds[1] = -1;
+            return;
+        }
+        for (int fd : fds) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+    }
+
+    InputWakeup::~InputWakeup() {
+        for (int fd : fds) if (fd >= 0) close(fd);
+    }
+
+    void InputWakeup::signal() {
+        char b = 1;
+        if (fds[1] >= 0 && write(fds[1], &b, 1) < 0) {
+            // pipe full: a wakeup is already pending
+        }
+    }
+
+    void InputWakeup::drain() {
+        char buf[64];
+        while (fds[0] >= 0 && read(fds[0], buf, sizeof(buf)) > 0) {}
+    }
+#endif
+}
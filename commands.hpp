@@ -0,0 +1,62 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+#ifdef _WIN32
+    #define NOMINMAX
+    #include <windows.h>
+#endif
+
+namespace ascii_render {
+
+    // what a key press, wheel step or terminal resize asks the pipeline to do
+    enum class Command { TogglePause, VolumeUp, VolumeDown, SpeedUp, SpeedDown, NextItem, Quit, Resize };
+
+    // Commands from the input thread to the playback pipeline. push() wakes a
+    // consumer blocked in wait_until(), so a key is acted on right away
+    // instead of after the current frame interval or pause tick.
+    class CommandQueue {
+    public:
+        void push(Command c);
+        bool pop(Command& c); // never blocks
+        void clear();
+
+        // true as soon as a command is waiting, false at the deadline
+        bool wait_until(std::chrono::steady_clock::time_point deadline);
+        void wait(); // until a command is waiting; resizes and quit arrive as commands too
+
+    private:
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::deque<Command> queue;
+    };
+
+    // Wakes a thread blocked on terminal input (poll() on POSIX, a wait on
+    // the console handle on Windows). signal() is async-signal-safe on POSIX,
+    // so the SIGWINCH handler can use it.
+    class InputWakeup {
+    public:
+        InputWakeup();
+        ~InputWakeup();
+        InputWakeup(const InputWakeup&) = delete;
+        InputWakeup& operator=(const InputWakeup&) = delete;
+
+        void signal();
+        void drain(); // consume pending signals after waking
+
+#ifdef _WIN32
+        HANDLE handle() const { return event; }
+#else
+        int fd() const { return fds[0]; }
+#endif
+
+    private:
+#ifdef _WIN32
+        HANDLE event;
+#else
+        int fds[2] = {-1, -1};
+#endif
+    };
+}
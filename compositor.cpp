@@ -0,0 +1,279 @@
+#include "compositor.hpp"
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+
+namespace ascii_render {
+
+    void Layer::place(int top, int left, int width, int height) {
+        if (top == top_ && left == left_ && width == cells.width && height == cells.height) return;
+        top_ = top;
+        left_ = left;
+        if (width != cells.width || height != cells.height) {
+            cells.resize(width, height);
+            dirty.assign(cells.height, 1);
+        }
+        geometry_changed = true;
+    }
+
+    void Layer::set_visible(bool visible) {
+        if (visible == visible_) return;
+        visible_ = visible;
+        geometry_changed = true;
+    }
+
+    void Layer::assign(const CellGrid& src) {
+        const int w = std::min(src.width, cells.width);
+        const int h = std::min(src.height, cells.height);
+        for (int y = 0; y < h; ++y) {
+            const char* sg = src.glyph_row(y);
+            const uint16_t* sc = src.color_row(y);
+            char* g = cells.glyph_row(y);
+            uint16_t* c = cells.color_row(y);
+            if (std::equal(sg, sg + w, g) && std::equal(sc, sc + w, c)) continue;
+            std::copy(sg, sg + w, g);
+            std::copy(sc, sc + w, c);
+            dirty[y] = 1;
+        }
+    }
+
+    void Layer::put_text(int row, int col, std::string_view text, uint16_t color) {
+        if (row < 0 || row >= cells.height) return;
+        char* g = cells.glyph_row(row);
+        uint16_t* c = cells.color_row(row);
+        for (size_t i = 0; i < text.size(); ++i) {
+            int x = col + (int)i;
+            if (x < 0) continue;
+            if (x >= cells.width) break;
+            if (g[x] == text[i] && c[x] == color) continue;
+            g[x] = text[i];
+            c[x] = color;
+            dirty[row] = 1;
+        }
+    }
+
+    void Layer::clear() {
+        for (int y = 0; y < cells.height; ++y) {
+            char* g = cells.glyph_row(y);
+            if (std::all_of(g, g + cells.width, [](char ch) { return ch == TRANSPARENT; })) continue;
+            std::fill(g, g + cells.width, TRANSPARENT);
+            dirty[y] = 1;
+        }
+    }
+
+    Layer& Compositor::add_layer() {
+        layers.push_back(std::make_unique<Layer>());
+        full_redraw = true;
+        return *layers.back();
+    }
+
+    void Compositor::resize(int cols, int rows) {
+        if (cols == front.width && rows == front.height) return;
+        front.resize(cols, rows);
+        line.resize(cols, 1);
+        row_dirty.assign(front.height, 1);
+        full_redraw = true;
+    }
+
+    void Compositor::invalidate() {
+        full_redraw = true;
+    }
+
+    // bottom to top; cells outside every layer are blank
+    void Compositor::compose_row(int y) {
+        char* g = line.glyph_row(0);
+        uint16_t* c = line.color_row(0);
+        std::fill(g, g + line.width, ' ');
+        std::fill(c, c + line.width, DEFAULT_COLOR);
+
+        for (auto& l : layers) {
+            if (!l->visible_) continue;
+            int ly = y - l->top_;
+            if (ly < 0 || ly >= l->cells.height) continue;
+            const char* lg = l->cells.glyph_row(ly);
+            const uint16_t* lc = l->cells.color_row(ly);
+            int x0 = std::max(0, l->left_);
+            int x1 = std::min(line.width, l->left_ + l->cells.width);
+            for (int x = x0; x < x1; ++x) {
+                char ch = lg[x - l->left_];
+                if (ch == TRANSPARENT) continue;
+                g[x] = ch;
+                // the background is fixed, so a space looks the same in every color
+                c[x] = ch == ' ' ? DEFAULT_COLOR : lc[x - l->left_];
+            }
+        }
+    }
+
+    // --- escape lengths; counts of 1 are left out ("\x1b[C", not "\x1b[1C") ---
+
+    static int decimal_len(int n) {
+        int len = 1;
+        while (n >= 10) { n /= 10; ++len; }
+        return len;
+    }
+
+    static int csi_count_len(int n) {
+        return n == 1 ? 3 : 3 + decimal_len(n);
+    }
+
+    static void put_csi_count(std::string& out, int n, char final) {
+        char buf[16];
+        if (n == 1) out.append(buf, std::snprintf(buf, sizeof(buf), "\x1b[%c", final));
+        else out.append(buf, std::snprintf(buf, sizeof(buf), "\x1b[%d%c", n, final));
+    }
+
+    // CUP to 0-based (y, x)
+    static int cup_len(int y, int x) {
+        if (x == 0) return y == 0 ? 3 : 3 + decimal_len(y + 1);
+        return 4 + decimal_len(y + 1) + decimal_len(x + 1);
+    }
+
+    static void put_cup(std::string& out, int y, int x) {
+        char buf[24];
+        if (x == 0 && y == 0) out += "\x1b[H";
+        else if (x == 0) out.append(buf, std::snprintf(buf, sizeof(buf), "\x1b[%dH", y + 1));
+        else out.append(buf, std::snprintf(buf, sizeof(buf), "\x1b[%d;%dH", y + 1, x + 1));
+    }
+
+    void Compositor::set_pen(std::string& out, uint16_t color) {
+        if (color == pen) return;
+        out += colors ? colors->sequence(color) : color_sequence(color);
+        pen = color;
+    }
+
+    // cheapest way from the tracked cursor to (y, x); the composed row in
+    // line is y's content, used when rewriting the gap is the cheapest move
+    void Compositor::move_cursor(std::string& out, int y, int x) {
+        if (cursor_y == y && cursor_x == x) return;
+
+        enum { ABS, REL, CR, CNL, GAP } how = ABS;
+        int best = cup_len(y, x);
+
+        if (cursor_y >= 0 && escapes.relative_moves) {
+            const int dy = y - cursor_y, dx = x - cursor_x;
+            const int vert = dy == 0 ? 0 : csi_count_len(std::abs(dy));
+            const int horiz = dx == 0 ? 0 : csi_count_len(std::abs(dx));
+            const int from_left = x == 0 ? 0 : csi_count_len(x);
+            if (vert + horiz < best) { best = vert + horiz; how = REL; }
+            if (vert + 1 + from_left < best) { best = vert + 1 + from_left; how = CR; }
+            if (dy > 0 && csi_count_len(dy) + from_left < best) { best = csi_count_len(dy) + from_left; how = CNL; }
+
+            if (escapes.rewrite_gaps && dy == 0 && dx > 0 && dx < best) {
+                // the gap is unchanged; rewriting it is only exact when the pen
+                // already matches (spaces match any pen)
+                const char* g = line.glyph_row(0);
+                const uint16_t* c = line.color_row(0);
+                bool same_pen = true;
+                for (int i = cursor_x; i < x && same_pen; ++i) same_pen = g[i] == ' ' || c[i] == pen;
+                if (same_pen) { best = dx; how = GAP; }
+            }
+        }
+
+        const int dy = y - cursor_y, dx = x - cursor_x;
+        switch (how) {
+        case ABS:
+            put_cup(out, y, x);
+            break;
+        case REL:
+            if (dy) put_csi_count(out, std::abs(dy), dy > 0 ? 'B' : 'A');
+            if (dx) put_csi_count(out, std::abs(dx), dx > 0 ? 'C' : 'D');
+            break;
+        case CR:
+            if (dy) put_csi_count(out, std::abs(dy), dy > 0 ? 'B' : 'A');
+            out += '\r';
+            if (x) put_csi_count(out, x, 'C');
+            break;
+        case CNL:
+            put_csi_count(out, dy, 'E');
+            if (x) put_csi_count(out, x, 'C');
+            break;
+        case GAP:
+            out.append(line.glyph_row(0) + cursor_x, dx);
+            break;
+        }
+        cursor_y = y;
+        cursor_x = x;
+    }
+
+    size_t Compositor::present(std::string& out) {
+        const int W = front.width, H = front.height;
+
+        bool all = full_redraw;
+        for (auto& l : layers) {
+            if (l->geometry_changed) all = true;
+        }
+        if (all) {
+            std::fill(row_dirty.begin(), row_dirty.end(), 1);
+        } else {
+            for (auto& l : layers) {
+                if (!l->visible_) continue;
+                for (int ly = 0; ly < l->cells.height; ++ly) {
+                    int y = l->top_ + ly;
+                    if (l->dirty[ly] && y >= 0 && y < H) row_dirty[y] = 1;
+                }
+            }
+        }
+        for (auto& l : layers) {
+            l->geometry_changed = false;
+            std::fill(l->dirty.begin(), l->dirty.end(), 0);
+        }
+
+        if (full_redraw) {
+            // unknown terminal contents: make every cell differ, start from a known pen
+            std::fill(front.glyphs.begin(), front.glyphs.end(), '\0');
+            out += "\x1b[0m\x1b[48;2;0;0;0m";
+            pen = UNKNOWN_PEN;
+            full_redraw = false;
+        }
+        // input handling may have moved the cursor since the last present
+        cursor_y = cursor_x = -1;
+
+        size_t changed = 0;
+        for (int y = 0; y < H; ++y) {
+            if (!row_dirty[y]) continue;
+            row_dirty[y] = 0;
+            compose_row(y);
+
+            const char* g = line.glyph_row(0);
+            const uint16_t* c = line.color_row(0);
+            char* fg = front.glyph_row(y);
+            uint16_t* fc = front.color_row(y);
+            auto same = [&](int x) { return g[x] == fg[x] && c[x] == fc[x]; };
+
+            int x = 0;
+            while (x < W) {
+                if (same(x)) { ++x; continue; }
+                move_cursor(out, y, x);
+
+                // a run of one glyph and color: with REP it may run over unchanged
+                // cells up to the last changed one, without it it stops at the first
+                int run = 1, end = x + 1;
+                while (x + run < W && g[x + run] == g[x] && c[x + run] == c[x]) {
+                    bool differs = !same(x + run);
+                    if (!differs && !escapes.rep) break;
+                    ++run;
+                    if (differs) end = x + run;
+                }
+                const int n = end - x;
+
+                if (g[x] != ' ') set_pen(out, c[x]);
+                out += g[x];
+                if (n > 1) {
+                    if (escapes.rep && csi_count_len(n - 1) < n - 1) put_csi_count(out, n - 1, 'b');
+                    else out.append(n - 1, g[x]);
+                }
+                for (int i = x; i < end; ++i) {
+                    if (!same(i)) ++changed;
+                    fg[i] = g[i];
+                    fc[i] = c[i];
+                }
+                x = end;
+                // after the last column the cursor waits to wrap: don't rely on it
+                cursor_x = x < W ? x : -1;
+                if (cursor_x < 0) cursor_y = -1;
+            }
+        }
+        return changed;
+    }
+}
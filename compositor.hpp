@@ -0,0 +1,91 @@
+#pragma once
+#include "ascii_render.hpp"
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ascii_render {
+
+    // glyph of a layer cell that shows whatever lies below it
+    constexpr char TRANSPARENT = '\0';
+
+    // A rectangle of cells placed on the screen. Content is written through
+    // assign()/put_text(), which compare against what the layer already
+    // holds and only mark the rows that really changed.
+    class Layer {
+    public:
+        void place(int top, int left, int width, int height);
+        void set_visible(bool visible);
+
+        // copy cells into the layer at (0, 0), clipped to the layer
+        void assign(const CellGrid& cells);
+        void put_text(int row, int col, std::string_view text, uint16_t color);
+        void clear(); // every cell transparent
+
+        int top() const { return top_; }
+        int left() const { return left_; }
+        int width() const { return cells.width; }
+        int height() const { return cells.height; }
+        bool visible() const { return visible_; }
+
+    private:
+        friend class Compositor;
+
+        int top_ = 0;
+        int left_ = 0;
+        bool visible_ = true;
+        bool geometry_changed = true; // placement or visibility: recompose everything
+        CellGrid cells;
+        std::vector<uint8_t> dirty;   // per layer row
+    };
+
+    // Which escape forms present() may use. Each change is written in the
+    // shortest form the enabled options allow.
+    struct EscapeOptions {
+        bool relative_moves = true; // CUF/CUB/CUU/CUD/CNL and CR when shorter than an absolute CUP
+        bool rewrite_gaps = true;   // rewrite a short unchanged gap instead of moving over it
+        // REP (CSI n b) for runs of one glyph. Only when asked for (--rep): PuTTY,
+        // Konsole and older VTE all say TERM=xterm-256color and get REP wrong.
+        bool rep = false;
+    };
+
+    // Stacks layers (later ones on top) and keeps the cells last written to
+    // the terminal. present() recomposes only rows some layer marked dirty and
+    // emits the cells that differ from the terminal, so an overlay changing
+    // does not touch the video under it and vice versa.
+    class Compositor {
+    public:
+        Layer& add_layer(); // the reference stays valid for the compositor's lifetime
+
+        void resize(int cols, int rows);
+        void invalidate(); // the terminal was cleared: next present redraws everything
+        void set_escape_options(const EscapeOptions& options) { escapes = options; }
+        // where cell colors get their SGR codes; nullptr (default) is the process-wide palette
+        void set_colors(const ColorTable* table) { colors = table; }
+
+        // appends escape sequences and glyphs to out; returns the number of cells changed
+        size_t present(std::string& out);
+
+        int cols() const { return front.width; }
+        int rows() const { return front.height; }
+
+    private:
+        void compose_row(int y);
+        void move_cursor(std::string& out, int y, int x);
+        void set_pen(std::string& out, uint16_t color);
+
+        std::vector<std::unique_ptr<Layer>> layers;
+        CellGrid front;                 // what the terminal shows
+        CellGrid line;                  // one composed row
+        std::vector<uint8_t> row_dirty; // per screen row
+        bool full_redraw = true;
+        uint32_t pen = UNKNOWN_PEN;     // foreground the terminal is set to
+        int cursor_y = -1;              // terminal cursor, -1 when unknown
+        int cursor_x = -1;
+        EscapeOptions escapes;
+        const ColorTable* colors = nullptr;
+
+        static constexpr uint32_t UNKNOWN_PEN = 0x10000;
+    };
+}
@@ -1,12 +1,32 @@
 #include "ascii_render.hpp"
+#include "thread_pool.hpp"
+#include "resample.hpp"
+#include "mosaic.hpp"
+#include "ordered_encoder.hpp"
+#include "bench.hpp"
+#include "commands.hpp"
+#include "compositor.hpp"
+#include "raw_input.hpp"
+#include "renderer.hpp"
+#include "thread_affinity.hpp"
+#include "trace.hpp"
 #include <iostream>
 #include <thread>
 #include <atomic>
 #include <mutex>
 #include <condition_variable>
-#include <queue>
+#include <deque>
 #include <string>
 #include <filesystem>
+#include <future>
+#include <memory>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <opencv2/opencv.hpp>
 #include <opencv2/core/ocl.hpp>
 #include <opencv2/core/version.hpp>
@@ -32,7 +52,13 @@ using namespace ascii_render;
         }
     }
 
+    // buffer size we last asked for: the WINDOW_BUFFER_SIZE_EVENT that follows is ours, not the user's
+    static std::atomic<int> requested_cols{0};
+    static std::atomic<int> requested_rows{0};
+
     void set_console_size(int width, int height) {
+        requested_cols.store(width);
+        requested_rows.store(height);
         HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
         COORD bufferSize = { (SHORT)width, (SHORT)height };
         SMALL_RECT windowSize = { 0, 0, (SHORT)(width - 1), (SHORT)(height - 1) };
@@ -41,6 +67,8 @@ using namespace ascii_render;
     }
 
     void remove_scrollbars(int width, int height) {
+        requested_cols.store(width);
+        requested_rows.store(height);
         HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
 
         COORD bufferSize;
@@ -56,6 +84,14 @@ using namespace ascii_render;
         SetConsoleWindowInfo(hOut, TRUE, &winSize);
     }
 
+    bool get_terminal_size(int& cols, int& rows) {
+        CONSOLE_SCREEN_BUFFER_INFO info;
+        if (!GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info)) return false;
+        cols = info.srWindow.Right - info.srWindow.Left + 1;
+        rows = info.srWindow.Bottom - info.srWindow.Top + 1;
+        return cols > 0 && rows > 0;
+    }
+
     void move_console_to_top_left() {
         HWND hwndConsole = GetConsoleWindow();
 
@@ -76,6 +112,8 @@ using namespace ascii_render;
     #include <sys/ioctl.h>
     #include <unistd.h>
     #include <signal.h>
+    #include <poll.h>
+    #include <cerrno>
     #include <cstring>
 
     using HMODULE_T = void*;
@@ -92,6 +130,14 @@ using namespace ascii_render;
         // no-op on POSIX — terminal emulator decides scrollbar presence
     }
 
+    bool get_terminal_size(int& cols, int& rows) {
+        struct winsize ws;
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) != 0 || ws.ws_col == 0 || ws.ws_row == 0) return false;
+        cols = ws.ws_col;
+        rows = ws.ws_row;
+        return true;
+    }
+
     void move_console_to_top_left() {
         // not portable: skip
     }
@@ -109,6 +155,7 @@ using libvlc_media_release_t = void (*)(libvlc_media_t*);
 using libvlc_audio_set_volume_t = void (*)(libvlc_media_player_t*, int);
 using libvlc_media_player_play_t = int (*)(libvlc_media_player_t*);
 using libvlc_media_player_set_pause_t = void (*)(libvlc_media_player_t*, int);
+using libvlc_media_player_set_rate_t = int (*)(libvlc_media_player_t*, float);
 using libvlc_media_player_get_time_t = int64_t (*)(libvlc_media_player_t*);
 using libvlc_media_player_get_length_t = int64_t (*)(libvlc_media_player_t*);
 using libvlc_media_player_stop_t = void (*)(libvlc_media_player_t*);
@@ -122,6 +169,7 @@ static libvlc_media_release_t libvlc_media_release = nullptr;
 static libvlc_audio_set_volume_t libvlc_audio_set_volume = nullptr;
 static libvlc_media_player_play_t libvlc_media_player_play = nullptr;
 static libvlc_media_player_set_pause_t libvlc_media_player_set_pause = nullptr;
+static libvlc_media_player_set_rate_t libvlc_media_player_set_rate = nullptr; // optional: speed keys then change video only
 static libvlc_media_player_get_time_t libvlc_media_player_get_time = nullptr;
 static libvlc_media_player_get_length_t libvlc_media_player_get_length = nullptr;
 static libvlc_media_player_stop_t libvlc_media_player_stop = nullptr;
@@ -137,6 +185,7 @@ bool load_vlc_functions(HMODULE_T vlc) {
     libvlc_audio_set_volume = (libvlc_audio_set_volume_t)GetProcAddress(vlc, "libvlc_audio_set_volume");
     libvlc_media_player_play = (libvlc_media_player_play_t)GetProcAddress(vlc, "libvlc_media_player_play");
     libvlc_media_player_set_pause = (libvlc_media_player_set_pause_t)GetProcAddress(vlc, "libvlc_media_player_set_pause");
+    libvlc_media_player_set_rate = (libvlc_media_player_set_rate_t)GetProcAddress(vlc, "libvlc_media_player_set_rate");
     libvlc_media_player_get_time = (libvlc_media_player_get_time_t)GetProcAddress(vlc, "libvlc_media_player_get_time");
     libvlc_media_player_get_length = (libvlc_media_player_get_length_t)GetProcAddress(vlc, "libvlc_media_player_get_length");
     libvlc_media_player_stop = (libvlc_media_player_stop_t)GetProcAddress(vlc, "libvlc_media_player_stop");
@@ -157,6 +206,7 @@ bool load_vlc_functions(HMODULE_T vlc) {
     libvlc_audio_set_volume = (libvlc_audio_set_volume_t)dlsym(vlc, "libvlc_audio_set_volume");
     libvlc_media_player_play = (libvlc_media_player_play_t)dlsym(vlc, "libvlc_media_player_play");
     libvlc_media_player_set_pause = (libvlc_media_player_set_pause_t)dlsym(vlc, "libvlc_media_player_set_pause");
+    libvlc_media_player_set_rate = (libvlc_media_player_set_rate_t)dlsym(vlc, "libvlc_media_player_set_rate");
     libvlc_media_player_get_time = (libvlc_media_player_get_time_t)dlsym(vlc, "libvlc_media_player_get_time");
     libvlc_media_player_get_length = (libvlc_media_player_get_length_t)dlsym(vlc, "libvlc_media_player_get_length");
     libvlc_media_player_stop = (libvlc_media_player_stop_t)dlsym(vlc, "libvlc_media_player_stop");
@@ -170,359 +220,969 @@ bool load_vlc_functions(HMODULE_T vlc) {
 }
 #endif
 
+// --- terminal resize tracking ---
+// set by SIGWINCH (POSIX) or a console buffer-size event (Windows), consumed by the processing thread
+static std::atomic<bool> resize_pending{false};
+// after the first resize the grid follows the terminal instead of the fixed width
+static std::atomic<bool> follow_terminal_size{false};
+// grid currently on screen; written only while the render thread is idle or by the processing thread
+static cv::Size shown_grid;
+
+// commands from the input thread to whichever pipeline is running, and the
+// wakeup that unblocks the input thread itself
+static CommandQueue commands;
+static InputWakeup input_wakeup;
+
+#ifndef _WIN32
+static void on_sigwinch(int) {
+    resize_pending.store(true);
+    input_wakeup.signal();
+}
+#endif
+
+// largest grid with the source aspect that fits the terminal, leaving 3 rows for the interface
+static cv::Size fit_grid(cv::Size source, int cols, int rows) {
+    double aspect = (double)source.height / source.width * 0.55; // glyphs are ~0.55 as wide as tall
+    int w = cols;
+    int h = static_cast<int>(aspect * w);
+    int max_h = std::max(1, rows - 3);
+    if (h > max_h) {
+        h = max_h;
+        w = std::min(cols, static_cast<int>(h / aspect));
+    }
+    return cv::Size(std::max(1, w), std::max(1, h));
+}
+
+static cv::Size terminal_grid(cv::Size source, cv::Size fallback) {
+    int cols = 0, rows = 0;
+    if (!get_terminal_size(cols, rows)) return fallback;
+    return fit_grid(source, cols, rows);
+}
+
 // --- input handling: Windows and POSIX implementations ---
 #ifdef _WIN32
-void handle_input(libvlc_media_player_t* mediaPlayer,
-                  std::atomic<bool>& running,
-                  std::atomic<bool>& paused,
-                  std::atomic<int>& volume)
+void handle_input(CommandQueue& commands, std::atomic<bool>& running)
 {
     HANDLE hIn = GetStdHandle(STD_INPUT_HANDLE);
     SetConsoleMode(hIn, ENABLE_EXTENDED_FLAGS | ENABLE_WINDOW_INPUT | ENABLE_MOUSE_INPUT);
 
     INPUT_RECORD record;
     DWORD events;
+    HANDLE waits[2] = { hIn, input_wakeup.handle() };
 
     while (running.load()) {
-        if (!ReadConsoleInput(hIn, &record, 1, &events)) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-            continue;
-        }
+        // blocks until console input or a wakeup (end of item, shutdown)
+        DWORD w = WaitForMultipleObjects(2, waits, FALSE, INFINITE);
+        if (w != WAIT_OBJECT_0) continue;
+        if (!ReadConsoleInput(hIn, &record, 1, &events)) continue;
 
         if (record.EventType == KEY_EVENT && record.Event.KeyEvent.bKeyDown) {
             int vk = record.Event.KeyEvent.wVirtualKeyCode;
-            if (vk == VK_ESCAPE) {
-                running.store(false);
-                break;
-            } else if (vk == VK_SPACE) {
-                bool new_paused = !paused.load();
-                paused.store(new_paused);
-                libvlc_media_player_set_pause(mediaPlayer, new_paused ? 1 : 0);
-            } else if (vk == VK_UP) {
-                int v = std::min(100, volume.load() + 5);
-                volume.store(v);
-                libvlc_audio_set_volume(mediaPlayer, v);
-            } else if (vk == VK_DOWN) {
-                int v = std::max(0, volume.load() - 5);
-                volume.store(v);
-                libvlc_audio_set_volume(mediaPlayer, v);
+            if (vk == VK_ESCAPE) commands.push(Command::Quit);
+            else if (vk == 'N') commands.push(Command::NextItem);
+            else if (vk == VK_SPACE) commands.push(Command::TogglePause);
+            else if (vk == VK_UP) commands.push(Command::VolumeUp);
+            else if (vk == VK_DOWN) commands.push(Command::VolumeDown);
+            else if (vk == VK_OEM_PLUS || vk == VK_ADD) commands.push(Command::SpeedUp);
+            else if (vk == VK_OEM_MINUS || vk == VK_SUBTRACT) commands.push(Command::SpeedDown);
+        }
+        else if (record.EventType == WINDOW_BUFFER_SIZE_EVENT) {
+            // set_console_size raises this event too; only a size we didn't ask for is a user resize
+            COORD size = record.Event.WindowBufferSizeEvent.dwSize;
+            if (size.X != requested_cols.load() || size.Y != requested_rows.load()) {
+                resize_pending.store(true);
+                commands.push(Command::Resize);
             }
         }
         else if (record.EventType == MOUSE_EVENT) {
             auto &me = record.Event.MouseEvent;
             if (me.dwEventFlags == MOUSE_WHEELED) {
                 short delta = GET_WHEEL_DELTA_WPARAM(me.dwButtonState);
-                if (delta > 0) {
-                    int v = std::min(100, volume.load() + 5);
-                    volume.store(v);
-                    libvlc_audio_set_volume(mediaPlayer, v);
-                } else {
-                    int v = std::max(0, volume.load() - 5);
-                    volume.store(v);
-                    libvlc_audio_set_volume(mediaPlayer, v);
-                }
+                commands.push(delta > 0 ? Command::VolumeUp : Command::VolumeDown);
             }
         }
     }
 }
 #else
-void handle_input(libvlc_media_player_t* mediaPlayer,
-                  std::atomic<bool>& running,
-                  std::atomic<bool>& paused,
-                  std::atomic<int>& volume)
+void handle_input(CommandQueue& commands, std::atomic<bool>& running)
 {
-    // ncurses must be initialized by caller
-    // getch() in non-blocking mode
+    // ncurses must be initialized by caller; getch() is non-blocking and
+    // only called once poll() reports input
     MEVENT event;
+    struct pollfd fds[2] = {
+        { STDIN_FILENO, POLLIN, 0 },
+        { input_wakeup.fd(), POLLIN, 0 },
+    };
 
     while (running.load()) {
-        int ch = getch();
-        if (ch == ERR) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-            continue;
-        }
-
-        if (ch == 27) { // ESC
-            running.store(false);
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
             break;
-        } else if (ch == ' ' || ch == KEY_ENTER) {
-            bool new_paused = !paused.load();
-            paused.store(new_paused);
-            if (libvlc_media_player_set_pause) libvlc_media_player_set_pause(mediaPlayer, new_paused ? 1 : 0);
-        } else if (ch == KEY_UP) {
-            int v = std::min(100, volume.load() + 5);
-            volume.store(v);
-            if (libvlc_audio_set_volume) libvlc_audio_set_volume(mediaPlayer, v);
-        } else if (ch == KEY_DOWN) {
-            int v = std::max(0, volume.load() - 5);
-            volume.store(v);
-            if (libvlc_audio_set_volume) libvlc_audio_set_volume(mediaPlayer, v);
-        } else if (ch == KEY_MOUSE) {
-            if (getmouse(&event) == OK) {
-                if (event.bstate & BUTTON4_PRESSED) {
-                    int v = std::min(100, volume.load() + 5);
-                    volume.store(v);
-                    if (libvlc_audio_set_volume) libvlc_audio_set_volume(mediaPlayer, v);
-                } else if (event.bstate & BUTTON5_PRESSED) {
-                    int v = std::max(0, volume.load() - 5);
-                    volume.store(v);
-                    if (libvlc_audio_set_volume) libvlc_audio_set_volume(mediaPlayer, v);
-                }
+        }
+        if (fds[1].revents & POLLIN) {
+            // woken by SIGWINCH or by the end of the item
+            input_wakeup.drain();
+            if (resize_pending.load()) commands.push(Command::Resize);
+        }
+        if (fds[0].revents & (POLLHUP | POLLERR | POLLNVAL)) fds[0].fd = -1; // stdin gone: wakeups only
+        if (!(fds[0].revents & POLLIN)) continue;
+
+        int ch;
+        while ((ch = getch()) != ERR) {
+            if (ch == 27) { // ESC
+                commands.push(Command::Quit);
+            } else if (ch == 'n' || ch == 'N') { // next playlist item
+                commands.push(Command::NextItem);
+            } else if (ch == ' ' || ch == KEY_ENTER) {
+                commands.push(Command::TogglePause);
+            } else if (ch == KEY_UP) {
+                commands.push(Command::VolumeUp);
+            } else if (ch == KEY_DOWN) {
+                commands.push(Command::VolumeDown);
+            } else if (ch == '+' || ch == '=') {
+                commands.push(Command::SpeedUp);
+            } else if (ch == '-' || ch == '_') {
+                commands.push(Command::SpeedDown);
+            } else if (ch == KEY_MOUSE && getmouse(&event) == OK) {
+                if (event.bstate & BUTTON4_PRESSED) commands.push(Command::VolumeUp);
+                else if (event.bstate & BUTTON5_PRESSED) commands.push(Command::VolumeDown);
             }
         }
     }
 }
 #endif
 
-// --- ascii queue + threads for processing/rendering (same logic as у вас) ---
-static std::queue<std::string> ascii_queue;
-static std::mutex ascii_mutex;
-static std::condition_variable ascii_cv;
+// --- startup timing: every step is recorded as a span from process start ---
+class StartupTimer {
+public:
+    using clock = std::chrono::steady_clock;
+
+    StartupTimer() : origin(clock::now()) {}
+
+    template <class F>
+    auto timed(const char* step, F&& f) {
+        auto t0 = clock::now();
+        struct Record {
+            StartupTimer* timer; const char* step; clock::time_point t0;
+            ~Record() { timer->record(step, t0, clock::now()); }
+        } rec{this, step, t0};
+        return f();
+    }
+
+    void record(const char* step, clock::time_point t0, clock::time_point t1) {
+        std::lock_guard<std::mutex> lock(mtx);
+        spans.push_back({step, ms(t0), ms(t1)});
+    }
+
+    // called by the render thread after every write; only the first one counts
+    void frame_shown() {
+        if (first_frame_ms.load() >= 0) return;
+        first_frame_ms.store(ms(clock::now()));
+    }
+
+    void print(std::ostream& os) {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::sort(spans.begin(), spans.end(), [](const Span& a, const Span& b) { return a.begin < b.begin; });
+        os << "startup (ms since launch):\n";
+        char line[96];
+        for (auto& sp : spans) {
+            std::snprintf(line, sizeof(line), "  %-14s %8.1f .. %8.1f  (%7.1f)\n",
+                          sp.step, sp.begin, sp.end, sp.end - sp.begin);
+            os << line;
+        }
+        double first = first_frame_ms.load();
+        if (first >= 0) std::snprintf(line, sizeof(line), "  time to first frame: %.1f ms\n", first);
+        else std::snprintf(line, sizeof(line), "  time to first frame: n/a (no frame was shown)\n");
+        os << line;
+    }
+
+private:
+    struct Span { const char* step; double begin; double end; };
 
-void render_thread(std::atomic<bool>& running) {
-    while (running.load() || !ascii_queue.empty()) {
-        std::unique_lock<std::mutex> lock(ascii_mutex);
-        ascii_cv.wait(lock, [&running] { return !ascii_queue.empty() || !running.load(); });
+    double ms(clock::time_point t) const {
+        return std::chrono::duration<double, std::milli>(t - origin).count();
+    }
+
+    clock::time_point origin;
+    std::mutex mtx;
+    std::vector<Span> spans;
+    std::atomic<double> first_frame_ms{-1.0};
+};
+
+static StartupTimer startup_timer;
+
+// --- frame latency: decode start -> written to the terminal, for --stats and the HUD ---
+// A uniform sample of all frames (reservoir sampling), so memory stays fixed
+// however long the session runs; the frame count and the max are exact.
+static const size_t LATENCY_SAMPLES = 8192;
+static std::vector<float> frame_latency_ms; // written by the render thread only
+static size_t frame_latency_count = 0;
+static float frame_latency_max = 0.0f;
+static std::minstd_rand frame_latency_rng;
+static std::mutex frame_latency_mutex;
+
+static void record_frame_latency(double ms) {
+    std::lock_guard<std::mutex> lock(frame_latency_mutex);
+    ++frame_latency_count;
+    frame_latency_max = std::max(frame_latency_max, (float)ms);
+    if (frame_latency_ms.size() < LATENCY_SAMPLES) {
+        frame_latency_ms.push_back((float)ms);
+        return;
+    }
+    // the n-th frame replaces a random sample with probability SAMPLES / n
+    size_t slot = std::uniform_int_distribution<size_t>(0, frame_latency_count - 1)(frame_latency_rng);
+    if (slot < LATENCY_SAMPLES) frame_latency_ms[slot] = (float)ms;
+}
+
+// p in [0, 1]; sorts its own copy
+static double latency_percentile(std::vector<float> v, double p) {
+    if (v.empty()) return 0.0;
+    size_t k = std::min(v.size() - 1, (size_t)(p * (v.size() - 1) + 0.5));
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+static void print_latency_stats(std::ostream& os) {
+    std::lock_guard<std::mutex> lock(frame_latency_mutex);
+    if (frame_latency_ms.empty()) return;
+    char line[160];
+    std::snprintf(line, sizeof(line), "latency: %zu frames, p50 %.2f ms, p99 %.2f ms, max %.2f ms (decode start to terminal write)\n",
+                  frame_latency_count, latency_percentile(frame_latency_ms, 0.5),
+                  latency_percentile(frame_latency_ms, 0.99), (double)frame_latency_max);
+    os << line;
+}
+
+// --- what the terminal can absorb: compositor + write time per video frame, averaged ---
+static std::atomic<double> terminal_frame_ms{0.0}; // written by the render thread only
+
+static void record_terminal_frame(double ms) {
+    double avg = terminal_frame_ms.load();
+    terminal_frame_ms.store(avg > 0.0 ? avg * 0.9 + ms * 0.1 : ms);
+}
+
+// --- playback speed steps, 0.25x to 4x ---
+static const double SPEEDS[] = {0.25, 0.5, 0.75, 1.0, 1.25, 1.5, 2.0, 3.0, 4.0};
+
+static double change_speed(double speed, int direction) {
+    const int n = (int)(sizeof(SPEEDS) / sizeof(SPEEDS[0]));
+    int i = 0;
+    while (i + 1 < n && SPEEDS[i] < speed) ++i;
+    return SPEEDS[std::clamp(i + direction, 0, n - 1)];
+}
+
+// --- render settings shared by all playback modes ---
+struct PlayerSettings {
+    bool rgb = true;             // <- change to false for better perf
+    int width = 100;             // lower -> better perf
+    int color_threads = 6;       // for color mode
+    bool frame_parallel = false; // --frame-parallel: encode whole frames concurrently, delivered in order
+    bool hud = false;            // --hud: fps / bytes overlay in the top-right corner
+    GlyphMode glyphs = GlyphMode::Luminance; // --edges: directional glyphs on outlines
+    Palette palette = Palette::Cube216;      // --palette=256: xterm-256 colors instead of 24-bit
+    EscapeOptions escapes;                   // --rep: REP for runs of one glyph, where the terminal has it
+};
+
+// --- render queue + threads for processing/rendering ---
+// one update per encoded frame; status-only updates (pause, volume) carry no cells
+struct RenderUpdate {
+    CellGrid video;
+    bool has_video = false;
+    StatusInfo status{};
+    std::chrono::steady_clock::time_point decode_start{}; // of the video frame, for latency
+};
+
+static std::deque<RenderUpdate> render_queue;
+static std::mutex render_mutex;
+static std::condition_variable render_cv;
+static bool redraw_pending = false; // guarded by render_mutex
+
+// drop queued frames of the old size and have the renderer repaint from scratch
+static void request_redraw() {
+    std::lock_guard<std::mutex> lock(render_mutex);
+    render_queue.clear();
+    redraw_pending = true;
+}
+
+// one renderer for the whole playlist: the processing thread encodes through
+// it, the render thread composes its screen. Besides the video layer that
+// screen holds the status bar below it and the HUD over its top-right corner.
+struct PlayerScreen {
+    Renderer renderer;
+    Layer& status = renderer.screen().add_layer();
+    Layer& hud = renderer.screen().add_layer();
+
+    explicit PlayerScreen(const RendererOptions& options) : renderer(options) {}
+};
+
+static RendererOptions renderer_options(const PlayerSettings& settings) {
+    RendererOptions options;
+    // frame-parallel: whole frames on one worker per core (at least one besides the caller);
+    // otherwise row blocks
+    options.threads = settings.frame_parallel ? (int)std::max(2u, std::thread::hardware_concurrency())
+                                              : settings.color_threads;
+    options.rgb = settings.rgb;
+    options.glyphs = settings.glyphs;
+    options.palette = settings.palette;
+    options.escapes = settings.escapes;
+    return options;
+}
 
-        while (!ascii_queue.empty()) {
-            std::string ascii = std::move(ascii_queue.front());
-            ascii_queue.pop();
+static const int HUD_WIDTH = 56;
+
+// sized for the next video picture, which renderer.show() then places at the top
+static void layout_screen(PlayerScreen& screen, int video_w, int video_h) {
+    const int cols = std::max(10, video_w);
+    screen.renderer.screen().resize(cols, video_h + 2);
+    screen.status.place(video_h, 0, cols, 2);
+    screen.hud.place(0, std::max(0, cols - HUD_WIDTH), std::min(HUD_WIDTH, cols), 1);
+    screen.hud.clear(); // a resized layer holds spaces; until the next HUD refresh, show the video
+}
+
+void render_thread(std::atomic<bool>& running, const PlayerSettings& settings, PlayerScreen& screen) {
+    Renderer& renderer = screen.renderer;
+    CellGrid status_cells;
+    std::string out;
+    apply_thread_role(ThreadRole::Writer);
+    trace_thread_name("terminal writer");
+    screen.hud.set_visible(settings.hud);
+
+    // HUD counters, refreshed twice a second
+    using clock = std::chrono::steady_clock;
+    auto hud_since = clock::now();
+    size_t hud_frames = 0, hud_bytes = 0, hud_cells = 0;
+    std::vector<float> hud_latency;
+
+    while (running.load() || !render_queue.empty()) {
+        std::unique_lock<std::mutex> lock(render_mutex);
+        render_cv.wait(lock, [&running] { return !render_queue.empty() || !running.load(); });
+
+        while (!render_queue.empty()) {
+            trace_instant("queue.pop", (int64_t)render_queue.size()); // arg: depth before the pop
+            RenderUpdate update = std::move(render_queue.front());
+            render_queue.pop_front();
+            bool redraw = redraw_pending;
+            redraw_pending = false;
             lock.unlock();
 
-            render_frame(ascii);
+            out.clear();
+            if (redraw) {
+                out += "\x1b[0m\x1b[2J";
+                renderer.invalidate();
+            }
+            if (update.has_video) {
+                if (update.video.width != renderer.video_size().width || update.video.height != renderer.video_size().height)
+                    layout_screen(screen, update.video.width, update.video.height);
+                renderer.show(update.video);
+                ++hud_frames;
+            }
+            if (renderer.video_size().width > 0) {
+                status_to_cells(update.status, renderer.video_size().width, settings.rgb, status_cells);
+                screen.status.assign(status_cells);
+            }
+
+            if (settings.hud) {
+                double secs = std::chrono::duration<double>(clock::now() - hud_since).count();
+                if (secs >= 0.5) {
+                    char text[HUD_WIDTH + 1];
+                    std::snprintf(text, sizeof(text), " %.1f fps  %zu B/frame  %zu cells  p99 %.1f ms ",
+                                  hud_frames / secs, hud_frames ? hud_bytes / hud_frames : 0,
+                                  hud_frames ? hud_cells / hud_frames : 0,
+                                  latency_percentile(hud_latency, 0.99));
+                    screen.hud.clear();
+                    int len = (int)std::strlen(text);
+                    screen.hud.put_text(0, screen.hud.width() - len, text, settings.rgb ? WHITE : DEFAULT_COLOR);
+                    hud_since = clock::now();
+                    hud_frames = hud_bytes = hud_cells = 0;
+                    hud_latency.clear();
+                }
+            }
+
+            auto write_start = clock::now();
+            size_t cells;
+            {
+                TraceSpan span("present");
+                cells = renderer.present(out);
+            }
+            hud_cells += cells;
+            hud_bytes += out.size();
+            if (!out.empty()) {
+                TraceSpan span("terminal write", (int64_t)out.size());
+                std::cout.write(out.data(), (std::streamsize)out.size());
+                std::cout.flush();
+            }
+            if (update.has_video) {
+                record_terminal_frame(std::chrono::duration<double, std::milli>(clock::now() - write_start).count());
+                startup_timer.frame_shown();
+                double ms = std::chrono::duration<double, std::milli>(clock::now() - update.decode_start).count();
+                record_frame_latency(ms);
+                if (settings.hud) hud_latency.push_back((float)ms);
+            }
 
             lock.lock();
         }
     }
 }
 
-void video_processing_thread(cv::VideoCapture& cap, int width, int height,
-                             libvlc_media_player_t* mediaPlayer,
+// --- encode work counters of the player's renderer, over all items, for --stats ---
+static void print_encode_stats(std::ostream& os, const FrameCache::Stats& t) {
+    uint64_t rows = t.rows_encoded + t.rows_reused;
+    char line[160];
+    std::snprintf(line, sizeof(line),
+                  "encode: %llu frames, %llu skipped as repeats, %llu rows encoded, %llu reused (%.1f%% of row work avoided)\n",
+                  (unsigned long long)t.frames, (unsigned long long)t.frames_skipped,
+                  (unsigned long long)t.rows_encoded, (unsigned long long)t.rows_reused,
+                  rows ? 100.0 * t.rows_reused / rows : 0.0);
+    os << line;
+}
+
+// --- playlist: one VLC instance, items opened ahead of time ---
+struct PlaylistItem {
+    std::string path;
+    std::string audio_path;            // what libvlc plays; empty: no audio
+    cv::VideoCapture cap;
+    RawFrameReader raw;                // --raw input: frames come from here instead of cap
+    double frame_duration = 0.0;
+    cv::Size source_size;
+    int height = 0;
+    std::vector<cv::Mat> first_frames; // decoded and resized before the item starts
+    libvlc_media_player_t* mediaPlayer = nullptr;
+    bool ok = false;
+};
+
+static bool is_video_file(const std::filesystem::path& p) {
+    static const char* exts[] = {".mp4", ".mkv", ".avi", ".webm", ".mov", ".m4v"};
+    std::string ext = p.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    for (auto e : exts) {
+        if (ext == e) return true;
+    }
+    return false;
+}
+
+// every argument is either a video file or a directory whose videos are played in name order
+static std::vector<std::string> collect_playlist(const std::vector<std::string>& args) {
+    namespace fs = std::filesystem;
+    std::vector<std::string> items;
+    for (auto& arg : args) {
+        std::error_code ec;
+        fs::path p(arg);
+        if (fs::is_directory(p, ec)) {
+            std::vector<std::string> dir_items;
+            for (auto& entry : fs::directory_iterator(p, ec)) {
+                if (entry.is_regular_file(ec) && is_video_file(entry.path()))
+                    dir_items.push_back(entry.path().string());
+            }
+            std::sort(dir_items.begin(), dir_items.end());
+            items.insert(items.end(), dir_items.begin(), dir_items.end());
+        } else {
+            items.push_back(p.string());
+        }
+    }
+    return items;
+}
+
+// the item's frame source: a container through VideoCapture, or raw frames
+static bool read_frame(PlaylistItem& item, cv::Mat& frame) {
+    return item.raw.isOpened() ? item.raw.read(frame) : item.cap.read(frame);
+}
+
+static bool grab_frame(PlaylistItem& item) {
+    return item.raw.isOpened() ? item.raw.grab() : item.cap.grab();
+}
+
+// decode the first frames now so the item can start without waiting on the decoder
+static bool prefetch_first_frames(PlaylistItem& item, int width, size_t prefetch_frames) {
+    cv::Mat frame;
+    while (item.first_frames.size() < prefetch_frames) {
+        TraceSpan span("prefetch frame");
+        if (!read_frame(item, frame)) break;
+        cv::Mat resized;
+        cv::resize(frame, resized, cv::Size(width, item.height), 0, 0, cv::INTER_LINEAR);
+        item.first_frames.push_back(std::move(resized));
+    }
+    return !item.first_frames.empty();
+}
+
+static bool open_item_video(PlaylistItem& item, int width, size_t prefetch_frames) {
+    item.audio_path = item.path;
+    if (!item.cap.open(item.path)) {
+        std::cerr << "Failed to open video file " << item.path << "\n";
+        return false;
+    }
+
+    double fps = item.cap.get(cv::CAP_PROP_FPS);
+    if (fps <= 0) {
+        std::cerr << "Invalid FPS value: " << fps << "\n";
+        return false;
+    }
+    item.frame_duration = 1.0 / fps;
+    item.source_size = cv::Size((int)item.cap.get(cv::CAP_PROP_FRAME_WIDTH), (int)item.cap.get(cv::CAP_PROP_FRAME_HEIGHT));
+    item.height = static_cast<int>((item.cap.get(cv::CAP_PROP_FRAME_HEIGHT) / item.cap.get(cv::CAP_PROP_FRAME_WIDTH)) * width * 0.55);
+    return prefetch_first_frames(item, width, prefetch_frames);
+}
+
+// --raw: size and rate are declared, audio (if any) comes from a separate file
+static bool open_item_raw(PlaylistItem& item, const RawFormat& format, const std::string& audio_path,
+                          int width, size_t prefetch_frames) {
+    item.audio_path = audio_path;
+    if (!item.raw.open(item.path, format)) {
+        std::cerr << "Failed to open raw input " << item.path << "\n";
+        return false;
+    }
+    item.frame_duration = 1.0 / format.fps;
+    item.source_size = format.size;
+    item.height = std::max(1, static_cast<int>((double)format.size.height / format.size.width * width * 0.55));
+    return prefetch_first_frames(item, width, prefetch_frames);
+}
+
+static bool open_item_audio(PlaylistItem& item, libvlc_instance_t* vlc_instance, int volume) {
+    if (item.audio_path.empty()) return true; // raw input without --audio: video only
+    libvlc_media_t* media = libvlc_media_new_path(vlc_instance, item.audio_path.c_str());
+    if (!media) {
+        std::cerr << "Failed to create media for " << item.audio_path << "\n";
+        return false;
+    }
+    item.mediaPlayer = libvlc_media_player_new_from_media(media);
+    libvlc_media_release(media);
+    if (!item.mediaPlayer) return false;
+    if (libvlc_audio_set_volume) libvlc_audio_set_volume(item.mediaPlayer, volume);
+    return true;
+}
+
+static std::unique_ptr<PlaylistItem> prepare_item(libvlc_instance_t* vlc_instance, const std::string& path,
+                                                  int width, int volume, size_t prefetch_frames) {
+    apply_thread_role(ThreadRole::Decode); // runs on its own async thread
+    trace_thread_name("prefetch");
+    auto item = std::make_unique<PlaylistItem>();
+    item->path = path;
+    item->ok = open_item_video(*item, width, prefetch_frames) &&
+               open_item_audio(*item, vlc_instance, volume);
+    return item;
+}
+
+static void release_item(PlaylistItem& item) {
+    if (item.mediaPlayer) {
+        if (libvlc_media_player_stop) libvlc_media_player_stop(item.mediaPlayer);
+        if (libvlc_media_player_release) libvlc_media_player_release(item.mediaPlayer);
+        item.mediaPlayer = nullptr;
+    }
+    item.cap.release();
+    item.raw.release();
+    item.first_frames.clear();
+}
+
+void video_processing_thread(PlaylistItem& item, cv::Size grid,
                              std::atomic<bool>& running,
+                             std::atomic<bool>& quit,
                              std::atomic<bool>& paused,
                              std::atomic<int>& volume,
-                             double frame_duration,
-                             bool rgb,
-                             int threads)
+                             std::atomic<double>& speed,
+                             const PlayerSettings& settings,
+                             Renderer& renderer)
 {
+    apply_thread_role(ThreadRole::Decode);
+    trace_thread_name("decode");
+    libvlc_media_player_t* mediaPlayer = item.mediaPlayer;
+    const double frame_duration = item.frame_duration;
+
     cv::Mat frame;
     cv::Mat resized_cpu;
     cv::Mat last_frame;
+    ResampleCache resampler;
+
+    // frame-parallel mode: each frame is encoded whole on one of the renderer's workers, a few frames ahead
+    std::unique_ptr<OrderedEncoder> ordered;
+    if (settings.frame_parallel) {
+        ThreadPool& pool = renderer.workers();
+        ordered = std::make_unique<OrderedEncoder>(pool, pool.size() * 2);
+    }
+    bool source_ended = false;
 
-    int frame_index = 0;
+    size_t prefetched = 0;
+    int frame_index = 0; // source frame; shown at start_time + frame_index * frame_duration / speed
     double start_time = (double)cv::getTickCount() / cv::getTickFrequency();
-    bool paused_frame_pushed = false;
+    double speed_local = speed.load();
+    bool video_pushed = false; // the renderer has a picture at the current grid
+    CellGrid paused_cells;
     bool first_frame_read = false;
 
     const size_t MAX_QUEUE = 3;
 
-    while (running.load()) {
-        bool paused_local = paused.load();
+    // source frames the next shown frame moves on by. The shown rate is held to
+    // the source rate and to what the terminal writer keeps up with; faster
+    // playback skips the frames in between instead of drawing more of them.
+    const double source_fps = 1.0 / frame_duration;
+    double step_carry = 0.0;
+    // a live stream (stdin, FIFO) is paced by its producer: every frame is shown
+    // as it arrives, and only a backlog of whole frames is skipped
+    const bool live = item.raw.isOpened() && item.raw.live();
+
+    auto next_step = [&] {
+        if (live) return std::max(1, (int)(item.first_frames.size() - prefetched + item.raw.frames_waiting()));
+        double shown_fps = source_fps;
+        double write_ms = terminal_frame_ms.load();
+        if (write_ms > 0.0) shown_fps = std::min(shown_fps, 1000.0 / write_ms);
+        step_carry += std::max(1.0, speed_local * source_fps / shown_fps);
+        int step = (int)step_carry;
+        step_carry -= step;
+        return step;
+    };
 
-        if (!paused_local) {
-            if (!cap.read(frame)) break;
-            first_frame_read = true;
+    // drop n source frames: grab() skips the color conversion, resize and encode
+    auto skip_frames = [&](int n) {
+        if (n <= 0) return true;
+        TraceSpan span("cap.grab", n);
+        for (; n > 0; --n) {
+            if (prefetched < item.first_frames.size()) { ++prefetched; continue; }
+            if (!grab_frame(item)) return false;
+        }
+        return true;
+    };
 
-            cv::resize(frame, resized_cpu, cv::Size(width, height), 0, 0, cv::INTER_LINEAR);
-            last_frame = resized_cpu.clone();
+    // next picture at grid size, step source frames on, from the prefetched frames first
+    auto next_grid_frame = [&](cv::Mat& out, int step) {
+        if (!skip_frames(step - 1)) return false;
+        if (prefetched < item.first_frames.size()) {
+            out = item.first_frames[prefetched++];
+            if (out.size() != grid) resampler.resample(out.clone(), out, grid);
+            return true;
+        }
+        {
+            TraceSpan span("cap.read");
+            if (!read_frame(item, frame)) return false;
+        }
+        TraceSpan span("resize");
+        resampler.resample(frame, out, grid);
+        return true;
+    };
 
-            double current_time = 0.0;
-            double duration = 0.0;
-            if (libvlc_media_player_get_time) current_time = libvlc_media_player_get_time(mediaPlayer) / 1000.0;
-            if (libvlc_media_player_get_length) duration = libvlc_media_player_get_length(mediaPlayer) / 1000.0;
-            double progress = duration > 0 ? current_time / duration : 0.0;
-            if (progress > 1.0) progress = 1.0;
+    // interface state is sampled when the frame is handed to the encoder
+    auto status_info = [&](bool paused_local) {
+        // without audio the position is the video's own; a live stream has no length
+        double current_time = frame_index * frame_duration;
+        double duration = 0.0;
+        if (!mediaPlayer) return StatusInfo{paused_local, 0.0, current_time, duration, volume.load(), speed_local};
+        if (libvlc_media_player_get_time) current_time = std::max<int64_t>(0, libvlc_media_player_get_time(mediaPlayer)) / 1000.0;
+        if (libvlc_media_player_get_length) duration = libvlc_media_player_get_length(mediaPlayer) / 1000.0;
+        double progress = duration > 0 ? current_time / duration : 0.0;
+        if (progress > 1.0) progress = 1.0;
+
+        return StatusInfo{paused_local, progress, current_time, duration, volume.load(), speed_local};
+    };
 
-            int volume_local = volume.load();
+    // whole-frame encoder for frame-parallel tasks
+    const OrderedEncoder::EncodeFn encode_whole = [&renderer](const cv::Mat& grid_frame, CellGrid& cells) {
+        renderer.encode_whole(grid_frame, cells);
+    };
 
-            std::string ascii_frame;
-            if (rgb) {
-                ascii_frame = frame_to_ascii_color(resized_cpu, paused_local, progress, current_time, duration, volume_local, threads);
-            } else {
-                ascii_frame = frame_to_ascii_mono(resized_cpu, paused_local, progress, current_time, duration, volume_local);
+    // a status-only update folds into the newest queued one; the compositor redraws just the status rows
+    auto push = [&](RenderUpdate&& update) {
+        TraceSpan span("queue.push", update.has_video);
+        std::lock_guard<std::mutex> lock(render_mutex);
+        if (!update.has_video && !render_queue.empty()) {
+            render_queue.back().status = update.status;
+        } else {
+            if (render_queue.size() >= MAX_QUEUE)
+                render_queue.pop_front();
+            render_queue.push_back(std::move(update));
+        }
+        render_cv.notify_one();
+    };
+    using clock = std::chrono::steady_clock;
+    auto push_cells = [&](CellGrid cells, const StatusInfo& st, clock::time_point decode_start) {
+        push(RenderUpdate{std::move(cells), true, st, decode_start});
+    };
+    auto push_status = [&](const StatusInfo& st) {
+        push(RenderUpdate{CellGrid(), false, st, clock::time_point()});
+    };
+    struct Submitted {
+        clock::time_point decode_start;
+        int step; // source frames it moves on by
+    };
+    std::deque<Submitted> submitted; // every frame in the ordered encoder, oldest first
+
+    // commands from the input thread; the status line is redrawn after a change
+    auto apply_commands = [&] {
+        bool status_changed = false;
+        Command c;
+        while (commands.pop(c)) {
+            switch (c) {
+            case Command::Quit:
+                quit.store(true);
+                running.store(false);
+                break;
+            case Command::NextItem:
+                running.store(false);
+                break;
+            case Command::TogglePause: {
+                bool new_paused = !paused.load();
+                paused.store(new_paused);
+                if (mediaPlayer && libvlc_media_player_set_pause) libvlc_media_player_set_pause(mediaPlayer, new_paused ? 1 : 0);
+                status_changed = true;
+                break;
             }
-
-            {
-                std::lock_guard<std::mutex> lock(ascii_mutex);
-                if (ascii_queue.size() >= MAX_QUEUE)
-                    ascii_queue.pop();
-                ascii_queue.push(std::move(ascii_frame));
-                ascii_cv.notify_one();
+            case Command::VolumeUp:
+            case Command::VolumeDown: {
+                int v = std::clamp(volume.load() + (c == Command::VolumeUp ? 5 : -5), 0, 100);
+                volume.store(v);
+                if (mediaPlayer && libvlc_audio_set_volume) libvlc_audio_set_volume(mediaPlayer, v);
+                status_changed = true;
+                break;
+            }
+            case Command::SpeedUp:
+            case Command::SpeedDown: {
+                double s = change_speed(speed.load(), c == Command::SpeedUp ? 1 : -1);
+                speed.store(s);
+                if (mediaPlayer && libvlc_media_player_set_rate) libvlc_media_player_set_rate(mediaPlayer, (float)s);
+                status_changed = true;
+                break;
             }
+            case Command::Resize:
+                break; // resize_pending is already set; the loop picks it up
+            }
+        }
+        if (status_changed && first_frame_read) push_status(status_info(paused.load()));
+    };
 
-            paused_frame_pushed = false;
+    bool was_paused = false;
+    while (running.load()) {
+        apply_commands();
+        if (!running.load()) break;
+        bool paused_local = paused.load();
+        if ((was_paused && !paused_local) || speed.load() != speed_local) {
+            // the playback clock stood still while paused, or runs at a new rate from here
+            speed_local = speed.load();
+            double now = (double)cv::getTickCount() / cv::getTickFrequency();
+            start_time = now - frame_index * frame_duration / speed_local;
         }
-        else {
-            if (first_frame_read && !paused_frame_pushed && !last_frame.empty()) {
-                double current_time = 0.0;
-                double duration = 0.0;
-                if (libvlc_media_player_get_time) current_time = libvlc_media_player_get_time(mediaPlayer) / 1000.0;
-                if (libvlc_media_player_get_length) duration = libvlc_media_player_get_length(mediaPlayer) / 1000.0;
-                double progress = duration > 0 ? current_time / duration : 0.0;
-                if (progress > 1.0) progress = 1.0;
-
-                int volume_local = volume.load();
-
-                std::string ascii_frame;
-                if (rgb) {
-                    ascii_frame = frame_to_ascii_color(last_frame, paused_local, progress, current_time, duration, volume_local, threads);
-                } else {
-                    ascii_frame = frame_to_ascii_mono(last_frame, paused_local, progress, current_time, duration, volume_local);
+        was_paused = paused_local;
+
+        if (resize_pending.exchange(false)) {
+            follow_terminal_size.store(true);
+            cv::Size fitted = terminal_grid(item.source_size, grid);
+            if (fitted != grid) {
+                grid = fitted;
+                shown_grid = grid;
+                // frames already encoding are at the old size: drop them but keep the clock
+                CellGrid stale;
+                while (ordered && ordered->next(stale) && !submitted.empty()) {
+                    frame_index += submitted.front().step;
+                    submitted.pop_front();
                 }
+                submitted.clear();
+                request_redraw();
+                // re-sample the paused picture from the last decoded source frame
+                if (!frame.empty()) resampler.resample(frame, last_frame, grid);
+                else if (!last_frame.empty()) resampler.resample(last_frame.clone(), last_frame, grid);
+                video_pushed = false;
+            }
+        }
 
-                {
-                    std::lock_guard<std::mutex> lock(ascii_mutex);
-                    if (ascii_queue.size() >= MAX_QUEUE)
-                        ascii_queue.pop();
-                    ascii_queue.push(std::move(ascii_frame));
-                    ascii_cv.notify_one();
+        if (!paused_local) {
+            if (ordered) {
+                while (!source_ended && !ordered->full()) {
+                    // a live stream isn't read ahead of its producer while frames are in flight
+                    if (live && !submitted.empty() && item.raw.frames_waiting() == 0) break;
+                    cv::Mat grid_frame; // fresh buffer: the task keeps it until delivered
+                    auto decode_start = clock::now();
+                    int step = next_step();
+                    if (!next_grid_frame(grid_frame, step)) { source_ended = true; break; }
+                    if (live) decode_start = clock::now(); // the read mostly waited for the producer
+                    submitted.push_back(Submitted{decode_start, step});
+                    // static content: a repeated frame is neither encoded nor drawn
+                    if (renderer.repeats(grid_frame)) ordered->submit(grid_frame, nullptr);
+                    else ordered->submit(grid_frame, encode_whole);
                 }
+                CellGrid cells;
+                if (!ordered->next(cells, &resized_cpu)) break;
+                Submitted shown = submitted.front();
+                submitted.pop_front();
+                frame_index += shown.step - 1;
+                if (cells.width > 0) push_cells(std::move(cells), status_info(false), shown.decode_start);
+                else push_status(status_info(false));
+            } else {
+                auto decode_start = clock::now();
+                int step = next_step();
+                if (!next_grid_frame(resized_cpu, step)) break;
+                if (live) decode_start = clock::now(); // the read mostly waited for the producer
+                frame_index += step - 1;
+                // static content: unchanged rows keep their cells, repeated frames are neither encoded nor drawn
+                if (renderer.update(resized_cpu)) push_cells(renderer.cells(), status_info(false), decode_start);
+                else push_status(status_info(false));
+            }
+            first_frame_read = true;
+            video_pushed = true;
 
-                paused_frame_pushed = true;
+            last_frame = resized_cpu.clone();
+        }
+        else {
+            // the picture only needs re-encoding after a resize; otherwise just the status changes
+            if (first_frame_read && !video_pushed && !last_frame.empty()) {
+                auto encode_start = clock::now();
+                renderer.encode(last_frame, paused_cells);
+                push_cells(paused_cells, status_info(true), encode_start);
+                video_pushed = true;
             }
-            std::this_thread::sleep_for(std::chrono::milliseconds(30));
+            // nothing changes on screen until a command arrives (a resize is one too)
+            commands.wait();
+            continue;
         }
 
-        double next_time = start_time + frame_index * frame_duration;
+        if (live) {
+            ++frame_index; // the next read waits for the producer, not for the clock
+            continue;
+        }
+
+        double next_time = start_time + frame_index * frame_duration / speed_local;
         double now = (double)cv::getTickCount() / cv::getTickFrequency();
         double sleep_time = next_time - now;
         if (sleep_time > 0) {
-            std::this_thread::sleep_for(std::chrono::duration<double>(sleep_time));
+            // wait for the next frame, but act on commands (volume, pause, quit) as they come
+            auto deadline = clock::now() + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(sleep_time));
+            while (commands.wait_until(deadline)) {
+                apply_commands();
+                if (!running.load() || paused.load() || resize_pending.load() || speed.load() != speed_local) break;
+            }
+        } else {
+            trace_instant("frame late", (int64_t)(-sleep_time * 1e6)); // arg: microseconds behind
         }
 
         ++frame_index;
     }
 
+    ordered.reset(); // waits for its tasks
+
     running.store(false);
-    ascii_cv.notify_all();
+    render_cv.notify_all();
+    input_wakeup.signal(); // the input thread leaves poll and sees running == false
 }
 
-// --- main ---
-int main(int argc, char* argv[]) {
-    #ifdef _WIN32
-        move_console_to_top_left();
-        freopen("nul", "w", stderr);
-    #else
-        freopen("/dev/null", "w", stderr);
-    #endif
+// --- playback of one item; the caller owns terminal setup and the VLC instance ---
+static void play_item(PlaylistItem& item, const PlayerSettings& settings, PlayerScreen& screen,
+                      std::atomic<bool>& quit,
+                      std::atomic<bool>& paused,
+                      std::atomic<int>& volume,
+                      std::atomic<double>& speed)
+{
+    std::atomic<bool> running(true);
+    libvlc_media_player_t* mediaPlayer = item.mediaPlayer;
 
-    cv::ocl::setUseOpenCL(true);
-    std::cout << "OpenCL: " << (cv::ocl::useOpenCL() ? "ENABLED" : "DISABLED") << std::endl;
+    cv::Size grid(settings.width, item.height);
+    if (follow_terminal_size.load()) grid = terminal_grid(item.source_size, grid);
 
-    if (argc < 2) {
-        std::cerr << "Usage: program <video_path>" << std::endl;
-        return 1;
+    if (grid != shown_grid) {
+        // a different grid would leave stale cells outside the new layout
+        request_redraw();
+        shown_grid = grid;
     }
 
-    cv::utils::logging::setLogLevel(cv::utils::logging::LOG_LEVEL_SILENT);
-    enableANSI();
-
-    // --- load libvlc dynamically ---
-    HMODULE_T vlc = nullptr;
+    std::string title = std::filesystem::path(item.path).filename().string();
 #ifdef _WIN32
-    vlc = LoadLibraryA("libvlc.dll");
-    if (!vlc) {
-        std::cerr << "Failed to load libvlc.dll\n";
-        return 1;
+    // once the user has resized the console, don't change its size again
+    if (!follow_terminal_size.load()) {
+        set_console_size(grid.width, grid.height + 3);
+        remove_scrollbars(grid.width, grid.height + 3);
     }
+    SetConsoleTitleA(title.c_str());
 #else
-    // try common SONAMEs
-    const char* candidates[] = {"libvlc.so.5", "libvlc.so"};
-    for (auto &c : candidates) {
-        vlc = dlopen(c, RTLD_LAZY | RTLD_LOCAL);
-        if (vlc) break;
-    }
-    if (!vlc) {
-        std::cerr << "Failed to load libvlc (tried libvlc.so.5 and libvlc.so). Make sure libvlc is installed.\n";
-        return 1;
-    }
+    // once the user has resized the terminal, don't ask it to change size again
+    if (!follow_terminal_size.load()) set_console_size(grid.width, grid.height + 3);
+    // set terminal title (most terminals support OSC)
+    std::cout << "\033]0;" << title << "\007";
 #endif
 
-    if (!load_vlc_functions(vlc)) {
-        std::cerr << "Failed to load one or more libvlc functions\n";
-#ifdef _WIN32
-        FreeLibrary(vlc);
-#else
-        dlclose(vlc);
-#endif
-        return 1;
-    }
+    paused.store(false);
+    // no warm-up sleep: the first frames are already decoded, the progress
+    // bar simply reads 0 until VLC reports a position
+    if (mediaPlayer && libvlc_media_player_play) libvlc_media_player_play(mediaPlayer);
+    // the item was prepared while the previous one played: volume and speed may have changed since
+    if (mediaPlayer && libvlc_audio_set_volume) libvlc_audio_set_volume(mediaPlayer, volume.load());
+    if (mediaPlayer && libvlc_media_player_set_rate) libvlc_media_player_set_rate(mediaPlayer, (float)speed.load());
 
-    bool rgb = true; // <- change to false for better perf
-    int width = 100; // lower -> better perf
-    int color_threads = 6; // for color mode
+    // spawn input/processing/render threads
+    std::thread input_thread([&] {
+        apply_thread_role(ThreadRole::Input);
+        trace_thread_name("input");
+        handle_input(commands, running);
+    });
+    std::thread processing_thread([&] {
+        video_processing_thread(item, grid, running, quit, paused, volume, speed, settings, screen.renderer);
+    });
+    std::thread drawing_thread(render_thread, std::ref(running), std::cref(settings), std::ref(screen));
 
-    std::atomic<bool> running(true);
-    std::atomic<bool> paused(false);
-    std::atomic<int> volume(50);
-    std::string video_path = argv[1];
+    if (processing_thread.joinable()) processing_thread.join();
+    if (drawing_thread.joinable()) drawing_thread.join();
+    if (input_thread.joinable()) input_thread.join();
 
-    const char* vlc_args[] = {
-        "--no-xlib",
-        "--plugin-path=./plugins",
-        "--no-video"
-    };
+    // keys that arrived after the item ended: only quit carries over
+    Command c;
+    while (commands.pop(c))
+        if (c == Command::Quit) quit.store(true);
+}
 
-    libvlc_instance_t* vlc_instance = libvlc_new(3, vlc_args);
-    if (!vlc_instance) {
-        std::cerr << "Failed to create VLC instance\n";
+// --- libvlc loading, run off the main thread during startup ---
+struct VlcRuntime {
+    HMODULE_T lib = nullptr;
+    libvlc_instance_t* instance = nullptr;
+    const char* error = nullptr;
+};
+
+static void close_vlc_library(HMODULE_T lib) {
 #ifdef _WIN32
-        FreeLibrary(vlc);
+    FreeLibrary(lib);
 #else
-        dlclose(vlc);
+    dlclose(lib);
 #endif
-        return 1;
-    }
+}
 
-    libvlc_media_t* media = libvlc_media_new_path(vlc_instance, video_path.c_str());
-    if (!media) {
-        std::cerr << "Failed to create media for " << video_path << "\n";
-        libvlc_release(vlc_instance);
+static VlcRuntime load_vlc_runtime() {
+    VlcRuntime rt;
+    startup_timer.timed("vlc_load", [&] {
 #ifdef _WIN32
-        FreeLibrary(vlc);
+        rt.lib = LoadLibraryA("libvlc.dll");
 #else
-        dlclose(vlc);
+        // try common SONAMEs
+        const char* candidates[] = {"libvlc.so.5", "libvlc.so"};
+        for (auto &c : candidates) {
+            rt.lib = dlopen(c, RTLD_LAZY | RTLD_LOCAL);
+            if (rt.lib) break;
+        }
 #endif
-        return 1;
-    }
-
-    libvlc_media_player_t* mediaPlayer = libvlc_media_player_new_from_media(media);
-    libvlc_media_release(media);
-    if (libvlc_audio_set_volume) libvlc_audio_set_volume(mediaPlayer, volume.load());
-
-    cv::VideoCapture cap(video_path);
-    if (!cap.isOpened()) {
-        std::cerr << "Failed to open video file " << video_path << "\n";
-        if (libvlc_media_player_release) libvlc_media_player_release(mediaPlayer);
-        libvlc_release(vlc_instance);
+        return 0;
+    });
+    if (!rt.lib) {
 #ifdef _WIN32
-        FreeLibrary(vlc);
+        rt.error = "Failed to load libvlc.dll";
 #else
-        dlclose(vlc);
+        rt.error = "Failed to load libvlc (tried libvlc.so.5 and libvlc.so). Make sure libvlc is installed.";
 #endif
-        return 1;
+        return rt;
     }
 
-    double fps = cap.get(cv::CAP_PROP_FPS);
-    if (fps <= 0) {
-        std::cerr << "Invalid FPS value: " << fps << "\n";
-        if (libvlc_media_player_release) libvlc_media_player_release(mediaPlayer);
-        libvlc_release(vlc_instance);
-#ifdef _WIN32
-        FreeLibrary(vlc);
-#else
-        dlclose(vlc);
-#endif
-        return 1;
+    if (!load_vlc_functions(rt.lib)) {
+        rt.error = "Failed to load one or more libvlc functions";
+        close_vlc_library(rt.lib);
+        rt.lib = nullptr;
+        return rt;
     }
-    double frame_duration = 1.0 / fps;
 
-    int height = static_cast<int>((cap.get(cv::CAP_PROP_FRAME_HEIGHT) / cap.get(cv::CAP_PROP_FRAME_WIDTH)) * width * 0.55);
+    const char* vlc_args[] = {
+        "--no-xlib",
+        "--plugin-path=./plugins",
+        "--no-video"
+    };
 
+    rt.instance = startup_timer.timed("vlc_init", [&] { return libvlc_new(3, vlc_args); });
+    if (!rt.instance) {
+        rt.error = "Failed to create VLC instance";
+        close_vlc_library(rt.lib);
+        rt.lib = nullptr;
+    }
+    return rt;
+}
+
+static void init_terminal() {
 #ifdef _WIN32
-    set_console_size(width, height + 3);
-    namespace fs = std::filesystem;
-    SetConsoleTitleA(fs::path(video_path).filename().string().c_str());
     HWND hwndConsole = GetConsoleWindow();
     LONG style = GetWindowLong(hwndConsole, GWL_STYLE);
     style &= ~WS_SIZEBOX;
@@ -530,7 +1190,6 @@ int main(int argc, char* argv[]) {
     SetWindowLong(hwndConsole, GWL_STYLE, style);
     SetWindowPos(hwndConsole, nullptr, 0, 0, 0, 0,
                 SWP_NOMOVE | SWP_NOSIZE | SWP_NOZORDER | SWP_FRAMECHANGED);
-    remove_scrollbars(width, height+3);
 #else
     // Initialize ncurses for input handling and terminal configs
     initscr();
@@ -539,40 +1198,254 @@ int main(int argc, char* argv[]) {
     keypad(stdscr, TRUE);
     nodelay(stdscr, TRUE); // non-blocking getch
     mousemask(ALL_MOUSE_EVENTS | BUTTON4_PRESSED | BUTTON5_PRESSED, NULL);
-    set_console_size(width, height + 3);
-    // set terminal title (most terminals support OSC)
-    std::string title = std::filesystem::path(video_path).filename().string();
-    std::cout << "\033]0;" << title << "\007";
+    // replaces ncurses' own handler: we draw with raw escapes, ncurses only reads keys
+    signal(SIGWINCH, on_sigwinch);
 #endif
+}
 
-    if (libvlc_media_player_play) libvlc_media_player_play(mediaPlayer);
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+// --- mosaic mode: all videos at once, no audio, no libvlc ---
+static int run_mosaic_mode(const std::vector<std::string>& playlist, const PlayerSettings& settings) {
+    std::atomic<bool> running(true);
+    std::atomic<bool> paused(false);
 
-    // spawn input/processing/render threads
-#ifdef _WIN32
-    std::thread input_thread(handle_input, mediaPlayer, std::ref(running), std::ref(paused), std::ref(volume));
-#else
-    std::thread input_thread([&] { handle_input(mediaPlayer, running, paused, volume); });
-#endif
+    init_terminal();
+    std::cout << "\033]0;mosaic\007";
 
-    std::thread processing_thread(video_processing_thread, std::ref(cap), width, height,
-                                  mediaPlayer, std::ref(running), std::ref(paused), std::ref(volume), frame_duration, rgb, color_threads);
-    std::thread drawing_thread(render_thread, std::ref(running));
+    std::thread input_thread([&] {
+        apply_thread_role(ThreadRole::Input);
+        trace_thread_name("input");
+        handle_input(commands, running);
+    });
+    apply_thread_role(ThreadRole::Decode); // this thread schedules the tiles
+    trace_thread_name("mosaic");
 
-    if (processing_thread.joinable()) processing_thread.join();
-    if (drawing_thread.joinable()) drawing_thread.join();
+    // one pool for every tile: decode + encode of all streams share its workers
+    run_mosaic(playlist, settings.rgb, settings.glyphs, settings.escapes, MosaicControls{running, paused, resize_pending, commands, get_terminal_size});
+
+    running.store(false);
+    input_wakeup.signal();
     if (input_thread.joinable()) input_thread.join();
+    std::cout << "\x1b[0m" << std::flush;
+#ifndef _WIN32
+    endwin(); // restore terminal
+#endif
+    return 0;
+}
 
-    if (libvlc_media_player_stop) libvlc_media_player_stop(mediaPlayer);
-    if (libvlc_media_player_release) libvlc_media_player_release(mediaPlayer);
-    libvlc_release(vlc_instance);
+// --pin-ROLE=CPUS / --nice-ROLE=N, e.g. --pin-encode=0-5 --nice-writer=-5
+static bool parse_thread_option(const std::string& a, ThreadPlacement& overrides) {
+    bool pin = a.rfind("--pin-", 0) == 0;
+    size_t eq = a.find('=');
+    if (eq == std::string::npos) return false;
+    size_t name_at = pin ? 6 : 7;
+    ThreadRole role;
+    if (!parse_role(a.substr(name_at, eq - name_at), role)) return false;
+    std::string value = a.substr(eq + 1);
+    if (pin) return parse_cpu_list(value, overrides[role].cpus);
+
+    char* end = nullptr;
+    long nice = std::strtol(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0' || nice < -20 || nice > 19) return false;
+    overrides[role].set_nice = true;
+    overrides[role].nice = (int)nice;
+    return true;
+}
 
-#ifdef _WIN32
-    FreeLibrary(vlc);
-#else
+// --trace: spans recorded during the run, written once its threads are done
+static void finish_trace(const std::string& path) {
+    if (path.empty()) return;
+    if (write_chrome_trace(path)) std::cout << "trace written to " << path << "\n";
+    else std::cout << "failed to write trace " << path << "\n";
+}
+
+// --- main ---
+int main(int argc, char* argv[]) {
+    #ifdef _WIN32
+        move_console_to_top_left();
+    #endif
+
+    PlayerSettings settings;
+    bool show_stats = false; // --stats: print the startup breakdown on exit
+    bool mosaic = false;     // --mosaic: tile all videos in one terminal
+    bool bench = false;      // --bench: headless encode/diff throughput run, no terminal or audio
+    bool pin = false;        // --pin: topology-aware CPU placement of the pipeline threads
+    std::string trace_path;  // --trace[=FILE]: Chrome trace of the pipeline, written on exit
+    RawFormat raw;           // --raw=WxH@FPS: headerless BGR24 frames from stdin ("-") or a FIFO
+    std::string audio_path;  // --audio=FILE: sound for --raw input
+    bool bad_option = false;
+    ThreadPlacement overrides;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a == "--stats") show_stats = true;
+        else if (a == "--mosaic") mosaic = true;
+        else if (a == "--bench") bench = true;
+        else if (a == "--frame-parallel") settings.frame_parallel = true;
+        else if (a == "--hud") settings.hud = true;
+        else if (a == "--rep") settings.escapes.rep = true;
+        else if (a == "--edges") settings.glyphs = GlyphMode::Edges;
+        else if (a == "--palette=216") settings.palette = Palette::Cube216;
+        else if (a == "--palette=256") settings.palette = Palette::Xterm256;
+        else if (a.rfind("--palette=", 0) == 0) bad_option = true;
+        else if (a == "--pin") pin = true;
+        else if (a == "--trace") trace_path = "ascii_trace.json";
+        else if (a.rfind("--trace=", 0) == 0) trace_path = a.substr(8);
+        else if (a.rfind("--raw=", 0) == 0) bad_option |= !raw.parse(a.substr(6));
+        else if (a.rfind("--audio=", 0) == 0) audio_path = a.substr(8);
+        else if (a.rfind("--pin-", 0) == 0 || a.rfind("--nice-", 0) == 0) bad_option |= !parse_thread_option(a, overrides);
+        else args.push_back(a);
+    }
+
+    // raw input is one stream, and the mosaic reads containers only
+    if (raw.valid() && (args.size() != 1 || mosaic)) bad_option = true;
+    if (!audio_path.empty() && !raw.valid()) bad_option = true;
+
+    if (args.empty() || bad_option) {
+        std::cerr << "Usage: program [--stats] [--mosaic] [--bench] [--frame-parallel] [--hud] [--rep] [--edges]"
+                     " [--palette=216|256] [--pin] [--pin-ROLE=CPUS] [--nice-ROLE=N] [--trace[=FILE]] <video_path|directory>...\n"
+                     "       program [--raw=WxH@FPS [--audio=FILE]] [options] <-|fifo>\n"
+                     "  ROLE is decode, encode, writer or input; CPUS like 0-3,6\n"
+                     "  --raw reads headerless BGR24 frames, e.g. ffmpeg -i in.mp4 -f rawvideo -pix_fmt bgr24 -" << std::endl;
+        return 1;
+    }
+
+    // explicit per-role options win over the topology default
+    ThreadPlacement placement = pin ? default_placement() : ThreadPlacement();
+    for (int r = 0; r < (int)ThreadRole::Count; ++r) {
+        if (!overrides.roles[r].cpus.empty()) placement.roles[r].cpus = overrides.roles[r].cpus;
+        if (overrides.roles[r].set_nice) {
+            placement.roles[r].set_nice = true;
+            placement.roles[r].nice = overrides.roles[r].nice;
+        }
+    }
+    set_thread_placement(placement);
+
+    if (!trace_path.empty()) {
+        trace_enable();
+        trace_thread_name("main");
+    }
+
+    std::vector<std::string> playlist = raw.valid() ? args : collect_playlist(args);
+    if (playlist.empty()) {
+        std::cerr << "No videos to play\n";
+        return 1;
+    }
+
+    // usage errors are out; from here on stderr is only library noise over the picture
+    #ifdef _WIN32
+        freopen("nul", "w", stderr);
+    #else
+        freopen("/dev/null", "w", stderr);
+    #endif
+
+    cv::ocl::setUseOpenCL(true);
+    std::cout << "OpenCL: " << (cv::ocl::useOpenCL() ? "ENABLED" : "DISABLED") << std::endl;
+
+    cv::utils::logging::setLogLevel(cv::utils::logging::LOG_LEVEL_SILENT);
+    enableANSI();
+
+    if (bench || mosaic) {
+        set_palette(settings.palette);
+        int rc = bench ? run_bench(playlist, settings.width, settings.color_threads, std::cout, raw)
+                       : run_mosaic_mode(playlist, settings);
+        finish_trace(trace_path);
+        return rc;
+    }
+
+    // libvlc load + init runs concurrently with opening and decoding the first video;
+    // raw input without --audio plays no sound and does without libvlc
+    const bool use_vlc = !raw.valid() || !audio_path.empty();
+    std::future<VlcRuntime> vlc_future;
+    if (use_vlc) vlc_future = std::async(std::launch::async, load_vlc_runtime);
+    // and so does building the renderer, whose palette lookup table takes a few ms
+    std::future<std::unique_ptr<PlayerScreen>> screen_future = std::async(std::launch::async, [&settings] {
+        return startup_timer.timed("palette", [&] { return std::make_unique<PlayerScreen>(renderer_options(settings)); });
+    });
+
+    const size_t prefetch_frames = 3; // frames decoded ahead for the next playlist item
+
+    std::atomic<bool> quit(false);
+    std::atomic<bool> paused(false);
+    std::atomic<int> volume(50);
+    std::atomic<double> speed(1.0); // kept across playlist items, like the volume
+
+    auto current = std::make_unique<PlaylistItem>();
+    current->path = playlist[0];
+    current->ok = startup_timer.timed("video_decode", [&] {
+        return raw.valid() ? open_item_raw(*current, raw, audio_path, settings.width, prefetch_frames)
+                           : open_item_video(*current, settings.width, prefetch_frames);
+    });
+
+    startup_timer.timed("terminal_init", [] { init_terminal(); return 0; });
+
+    std::unique_ptr<PlayerScreen> screen = screen_future.get();
+    // the first frame waits for libvlc: the item's media player has to exist
+    // before play_item starts the clock, so audio and video begin together
+    VlcRuntime vlc;
+    if (use_vlc) vlc = vlc_future.get();
+    if (use_vlc && !vlc.instance) {
+#ifndef _WIN32
+        endwin();
+#endif
+        std::cerr << vlc.error << "\n";
+        release_item(*current);
+        return 1;
+    }
+    libvlc_instance_t* vlc_instance = vlc.instance;
+
+    if (current->ok) {
+        current->ok = startup_timer.timed("vlc_media", [&] {
+            return open_item_audio(*current, vlc_instance, volume.load());
+        });
+    }
+    if (playlist.size() == 1 && !current->ok) {
+#ifndef _WIN32
+        endwin();
+#endif
+        release_item(*current);
+        if (vlc_instance) libvlc_release(vlc_instance);
+        if (vlc.lib) close_vlc_library(vlc.lib);
+        return 1;
+    }
+
+    for (size_t i = 0; current; ++i) {
+        // open the next item in the background while this one plays
+        std::future<std::unique_ptr<PlaylistItem>> next;
+        if (i + 1 < playlist.size()) {
+            next = std::async(std::launch::async, prepare_item, vlc_instance, playlist[i + 1],
+                              settings.width, volume.load(), prefetch_frames);
+        }
+
+        if (current->ok) {
+            play_item(*current, settings, *screen, quit, paused, volume, speed);
+        }
+        release_item(*current);
+        current.reset();
+
+        if (next.valid()) {
+            current = next.get();
+            if (quit.load()) {
+                release_item(*current);
+                current.reset();
+            }
+        }
+    }
+
+    if (vlc_instance) libvlc_release(vlc_instance);
+
+    std::cout << "\x1b[0m" << std::flush; // the compositor leaves the last cell color set
+#ifndef _WIN32
     endwin(); // restore terminal
-    dlclose(vlc);
 #endif
+    if (vlc.lib) close_vlc_library(vlc.lib);
+
+    if (show_stats) {
+        startup_timer.print(std::cout);
+        print_encode_stats(std::cout, screen->renderer.cache_stats());
+        print_latency_stats(std::cout);
+        print_thread_placement(std::cout);
+    }
+    finish_trace(trace_path);
 
     return 0;
 }
@@ -0,0 +1,252 @@
+#include "mosaic.hpp"
+#include "ascii_render.hpp"
+#include "commands.hpp"
+#include "compositor.hpp"
+#include "resample.hpp"
+#include "thread_pool.hpp"
+#include "trace.hpp"
+#include <iostream>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <cmath>
+#include <algorithm>
+#include <cstdlib>
+#include <opencv2/opencv.hpp>
+
+using namespace ascii_render;
+
+namespace {
+
+    struct Tile {
+        std::string path;
+        cv::VideoCapture cap;
+        double frame_duration = 0.0;
+        double next_pts = 0.0;   // playback play_clock time of the next frame to show
+        cv::Size source;
+        cv::Size grid;           // picture size inside the cell
+        cv::Mat frame;
+        cv::Mat small;
+        ResampleCache resampler;
+        CellGrid cells;
+        Layer* layer = nullptr;
+        bool done = false;
+    };
+
+    struct Layout {
+        int cols = 1, rows = 1;      // tiles per row / column
+        int cell_w = 1, cell_h = 1;  // characters per tile cell
+    };
+
+    // FFmpeg gives every capture its own decoder threads, one per core; with
+    // 16 tiles that is 16x cores next to the pool. One thread per tile keeps
+    // all decoding on the pool workers.
+    bool open_capture(cv::VideoCapture& cap, const std::string& path) {
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 6)
+        return cap.open(path, cv::CAP_ANY, {cv::CAP_PROP_N_THREADS, 1});
+#else
+        return cap.open(path); // threads come from OPENCV_FFMPEG_CAPTURE_OPTIONS, see run_mosaic
+#endif
+    }
+
+    bool open_tile(Tile& tile) {
+        if (!open_capture(tile.cap, tile.path)) return false;
+        double fps = tile.cap.get(cv::CAP_PROP_FPS);
+        if (fps <= 0) return false;
+        tile.frame_duration = 1.0 / fps;
+        tile.source = cv::Size((int)tile.cap.get(cv::CAP_PROP_FRAME_WIDTH), (int)tile.cap.get(cv::CAP_PROP_FRAME_HEIGHT));
+        return tile.source.width > 0 && tile.source.height > 0;
+    }
+
+    // one column/row gap between cells, last row is the status line
+    Layout make_layout(size_t n, int term_cols, int term_rows) {
+        Layout l;
+        l.cols = std::max(1, (int)std::ceil(std::sqrt((double)n)));
+        l.rows = std::max(1, (int)((n + l.cols - 1) / l.cols));
+        l.cell_w = std::max(1, (term_cols - (l.cols - 1)) / l.cols);
+        l.cell_h = std::max(1, (term_rows - 1 - (l.rows - 1)) / l.rows);
+        return l;
+    }
+
+    cv::Size fit_cell(cv::Size source, const Layout& l) {
+        double aspect = (double)source.height / source.width * 0.55; // glyphs are ~0.55 as wide as tall
+        int w = l.cell_w;
+        int h = static_cast<int>(aspect * w);
+        if (h > l.cell_h) {
+            h = l.cell_h;
+            w = std::min(l.cell_w, static_cast<int>(h / aspect));
+        }
+        return cv::Size(std::max(1, w), std::max(1, h));
+    }
+
+    // runs on a pool worker: catch up by grabbing (no decode) frames that are
+    // already late, then decode, resample and encode the one to show
+    void advance_tile(Tile& tile, double play_clock, bool rgb, GlyphMode glyphs) {
+        while (tile.next_pts + tile.frame_duration <= play_clock) {
+            TraceSpan span("cap.grab");
+            if (!tile.cap.grab()) { tile.done = true; return; }
+            tile.next_pts += tile.frame_duration;
+        }
+        {
+            TraceSpan span("cap.read");
+            if (!tile.cap.read(tile.frame)) { tile.done = true; return; }
+        }
+        tile.next_pts += tile.frame_duration;
+
+        {
+            TraceSpan span("resize");
+            tile.resampler.resample(tile.frame, tile.small, tile.grid);
+        }
+        frame_to_cells(tile.small, rgb, tile.cells, 1, glyphs);
+    }
+
+    // each tile is a layer centered in its cell; the status line is the last row
+    void place_layers(const std::vector<std::unique_ptr<Tile>>& tiles, const Layout& l, Layer& status) {
+        for (size_t i = 0; i < tiles.size(); ++i) {
+            Tile& t = *tiles[i];
+            int r = (int)i / l.cols, c = (int)i % l.cols;
+            int top = r * (l.cell_h + 1) + (l.cell_h - t.grid.height) / 2;
+            int left = c * (l.cell_w + 1) + (l.cell_w - t.grid.width) / 2;
+            t.layer->place(top, left, t.grid.width, t.grid.height);
+        }
+        status.place(l.rows * (l.cell_h + 1) - 1, 0, l.cols * l.cell_w + (l.cols - 1), 1);
+    }
+
+    void status_text(Layer& status, size_t tiles, bool paused, bool rgb) {
+        std::string text = " mosaic: " + std::to_string(tiles) + " videos   " + (paused ? "||" : "|>") + "   Esc: quit";
+        text.resize(status.width(), ' ');
+        status.put_text(0, 0, text, rgb ? WHITE : DEFAULT_COLOR);
+    }
+}
+
+void run_mosaic(const std::vector<std::string>& paths, bool rgb, GlyphMode glyphs,
+                const EscapeOptions& escapes, const MosaicControls& controls) {
+    // all parallelism goes through our pool; OpenCV's own workers would oversubscribe it
+    cv::setNumThreads(0);
+#if !(CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 6))
+    // no per-capture thread count before OpenCV 4.6: the FFmpeg backend reads
+    // its options at every open, so set them once before any tile opens
+    if (!std::getenv("OPENCV_FFMPEG_CAPTURE_OPTIONS")) {
+    #ifdef _WIN32
+        _putenv_s("OPENCV_FFMPEG_CAPTURE_OPTIONS", "threads;1");
+    #else
+        setenv("OPENCV_FFMPEG_CAPTURE_OPTIONS", "threads;1", 0);
+    #endif
+    }
+#endif
+    ThreadPool& pool = shared_pool();
+
+    std::vector<std::unique_ptr<Tile>> tiles;
+    for (auto& p : paths) {
+        auto t = std::make_unique<Tile>();
+        t->path = p;
+        tiles.push_back(std::move(t));
+    }
+    {
+        TaskBatch opening(pool);
+        for (auto& t : tiles) {
+            Tile* tile = t.get();
+            opening.run([tile] { tile->done = !open_tile(*tile); });
+        }
+    }
+    tiles.erase(std::remove_if(tiles.begin(), tiles.end(),
+                               [](const std::unique_ptr<Tile>& t) { return t->done; }),
+                tiles.end());
+    if (tiles.empty()) return;
+
+    Compositor screen;
+    screen.set_escape_options(escapes);
+    for (auto& t : tiles) t->layer = &screen.add_layer();
+    Layer& status = screen.add_layer();
+
+    Layout layout;
+    auto relayout = [&] {
+        int cols = 100, rows = 40;
+        controls.terminal_size(cols, rows);
+        layout = make_layout(tiles.size(), cols, rows);
+        for (auto& t : tiles) {
+            t->grid = fit_cell(t->source, layout);
+            t->cells.resize(t->grid.width, t->grid.height);
+            t->resampler.clear();
+        }
+        screen.resize(layout.cols * layout.cell_w + (layout.cols - 1), layout.rows * (layout.cell_h + 1));
+        place_layers(tiles, layout, status);
+        screen.invalidate();
+        std::cout << "\x1b[0m\x1b[2J";
+    };
+    relayout();
+
+    using clock_t = std::chrono::steady_clock;
+    auto last = clock_t::now();
+    double play_clock = 0.0;          // playback play_clock, stands still while paused
+    bool shown_paused = false;
+    bool dirty = true;
+    std::string out;
+
+    while (controls.running.load()) {
+        // every pass, behind schedule or not: a busy mosaic must still see Esc and Space
+        Command c;
+        while (controls.commands.pop(c)) {
+            if (c == Command::TogglePause) controls.paused.store(!controls.paused.load());
+            else if (c == Command::Quit || c == Command::NextItem) controls.running.store(false);
+            // no audio to change volume of, tiles always play at 1x; Resize arrives through resize_pending
+        }
+        if (!controls.running.load()) break;
+
+        auto now = clock_t::now();
+        double dt = std::chrono::duration<double>(now - last).count();
+        last = now;
+
+        bool paused = controls.paused.load();
+        if (!paused && !shown_paused) play_clock += dt; // the time just waited counts only if we were playing
+        if (paused != shown_paused) { shown_paused = paused; dirty = true; }
+
+        if (controls.resize_pending.exchange(false)) {
+            relayout();
+            dirty = true;
+        }
+
+        size_t alive = 0;
+        double next_due = play_clock + 0.05;
+        TaskBatch due(pool);
+        for (auto& t : tiles) {
+            if (t->done) continue;
+            ++alive;
+            if (paused) continue;
+            if (t->next_pts <= play_clock) {
+                Tile* tile = t.get();
+                due.run([tile, play_clock, rgb, glyphs] { advance_tile(*tile, play_clock, rgb, glyphs); });
+                dirty = true;
+            }
+        }
+        if (alive == 0) break;
+        due.wait();
+
+        if (dirty) {
+            // only tiles that advanced (and the status line) produce output
+            for (auto& t : tiles) t->layer->assign(t->cells);
+            status_text(status, tiles.size(), paused, rgb);
+            out.clear();
+            {
+                TraceSpan span("present");
+                screen.present(out);
+            }
+            TraceSpan span("terminal write", (int64_t)out.size());
+            std::cout.write(out.data(), (std::streamsize)out.size());
+            std::cout.flush();
+            dirty = false;
+        }
+
+        for (auto& t : tiles) {
+            if (!t->done) next_due = std::min(next_due, t->next_pts);
+        }
+        // sleep until the next tile is due, waking early for commands; paused, until a command
+        if (paused) {
+            controls.commands.wait();
+        } else {
+            double wait = next_due - (play_clock + std::chrono::duration<double>(clock_t::now() - last).count());
+            if (wait > 0)
+                controls.commands.wait_until(clock_t::now() + std::chrono::duration_cast<clock_t::duration>(std::chrono::duration<double>(wait)));
+        }
+    }
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "ascii_render.hpp"
+#include "commands.hpp"
+#include "compositor.hpp"
+#include <atomic>
+#include <string>
+#include <vector>
+
+// state shared with the player's input/terminal handling
+struct MosaicControls {
+    std::atomic<bool>& running;
+    std::atomic<bool>& paused;
+    std::atomic<bool>& resize_pending;
+    ascii_render::CommandQueue& commands; // keys from the input thread; wakes the refresh loop
+    bool (*terminal_size)(int& cols, int& rows);
+};
+
+// Plays all paths at once, tiled in one terminal, without audio. Every tile
+// keeps its own fps; decode, resample and encode of the due tiles run as
+// tasks on the shared pool; every tile is a compositor layer, so a refresh
+// writes only the cells of tiles that changed. Returns when every tile has ended or running is cleared.
+void run_mosaic(const std::vector<std::string>& paths, bool rgb, ascii_render::GlyphMode glyphs,
+                const ascii_render::EscapeOptions& escapes, const MosaicControls& controls);
@@ -0,0 +1,65 @@
+#include "ordered_encoder.hpp"
+#include "thread_pool.hpp"
+#include "trace.hpp"
+#include <algorithm>
+
+namespace ascii_render {
+
+    OrderedEncoder::OrderedEncoder(ThreadPool& pool, size_t max_in_flight)
+        : pool(pool), max_in_flight(std::max<size_t>(1, max_in_flight)) {}
+
+    OrderedEncoder::~OrderedEncoder() {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv_done.wait(lock, [this] { return running_tasks == 0; });
+    }
+
+    bool OrderedEncoder::full() const {
+        return in_flight() >= max_in_flight;
+    }
+
+    size_t OrderedEncoder::in_flight() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return (size_t)(next_seq - next_out);
+    }
+
+    void OrderedEncoder::submit(const cv::Mat& grid_frame, EncodeFn encode) {
+        uint64_t seq;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            seq = next_seq++;
+            if (!encode) {
+                // nothing to encode: the slot completes at once with an empty grid
+                done.emplace(seq, Result{CellGrid(), grid_frame});
+                cv_done.notify_all();
+                return;
+            }
+            ++running_tasks;
+        }
+        pool.enqueue([this, seq, grid_frame, encode = std::move(encode)] {
+            Result r;
+            {
+                TraceSpan span("encode frame", (int64_t)seq);
+                encode(grid_frame, r.cells);
+            }
+            r.grid_frame = grid_frame;
+            // notify under the lock: the destructor may run as soon as running_tasks hits 0
+            std::lock_guard<std::mutex> lock(mtx);
+            done.emplace(seq, std::move(r));
+            --running_tasks;
+            cv_done.notify_all();
+        });
+    }
+
+    bool OrderedEncoder::next(CellGrid& out, cv::Mat* grid_frame) {
+        std::unique_lock<std::mutex> lock(mtx);
+        if (next_out == next_seq) return false;
+        cv_done.wait(lock, [this] { return done.count(next_out) != 0; });
+
+        auto it = done.find(next_out);
+        out = std::move(it->second.cells);
+        if (grid_frame) *grid_frame = it->second.grid_frame;
+        done.erase(it);
+        ++next_out;
+        return true;
+    }
+}
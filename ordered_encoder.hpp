@@ -0,0 +1,50 @@
+#pragma once
+#include "ascii_render.hpp"
+#include <opencv2/opencv.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+
+class ThreadPool;
+
+namespace ascii_render {
+
+    // Frame-level parallelism: every submitted frame is encoded whole by one
+    // pool task, several frames are in flight at once, and a reorder buffer
+    // hands the results back strictly in submission order.
+    class OrderedEncoder {
+    public:
+        using EncodeFn = std::function<void(const cv::Mat&, CellGrid&)>;
+
+        OrderedEncoder(ThreadPool& pool, size_t max_in_flight);
+        ~OrderedEncoder(); // waits for outstanding tasks
+
+        bool full() const;
+        size_t in_flight() const;
+
+        // grid_frame must not be written to by the caller afterwards; an empty
+        // encode marks a frame that needs no work and is delivered as an empty grid
+        void submit(const cv::Mat& grid_frame, EncodeFn encode);
+
+        // blocks until the oldest outstanding frame is encoded; false when nothing is in flight
+        bool next(CellGrid& out, cv::Mat* grid_frame = nullptr);
+
+    private:
+        struct Result {
+            CellGrid cells;
+            cv::Mat grid_frame;
+        };
+
+        ThreadPool& pool;
+        const size_t max_in_flight;
+
+        mutable std::mutex mtx;
+        std::condition_variable cv_done;
+        std::map<uint64_t, Result> done; // reorder buffer, keyed by sequence number
+        uint64_t next_seq = 0;           // next sequence number to hand out
+        uint64_t next_out = 0;           // next sequence number to deliver
+        size_t running_tasks = 0;
+    };
+}
@@ -0,0 +1,141 @@
+#include "raw_input.hpp"
+#include <algorithm>
+#include <cstdio>
+
+#ifdef _WIN32
+    #define NOMINMAX
+    #include <windows.h>
+    #include <fcntl.h>
+    #include <io.h>
+#else
+    #include <cerrno>
+    #include <fcntl.h>
+    #include <sys/ioctl.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace ascii_render {
+
+    bool RawFormat::parse(const std::string& spec) {
+        int w = 0, h = 0;
+        double rate = 0.0;
+        char tail = 0;
+        if (std::sscanf(spec.c_str(), "%dx%d@%lf%c", &w, &h, &rate, &tail) != 3) return false;
+        size = cv::Size(w, h);
+        fps = rate;
+        return valid();
+    }
+
+#ifdef _WIN32
+    // the pipe keeps its own descriptor; console input is read from CONIN$
+    static int take_stdin() {
+        int fd = _dup(_fileno(stdin));
+        if (fd < 0) return -1;
+        _setmode(fd, _O_BINARY);
+        HANDLE con = CreateFileA("CONIN$", GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                 nullptr, OPEN_EXISTING, 0, nullptr);
+        if (con != INVALID_HANDLE_VALUE) SetStdHandle(STD_INPUT_HANDLE, con);
+        return fd;
+    }
+
+    static int open_path(const std::string& path) { return _open(path.c_str(), _O_RDONLY | _O_BINARY); }
+    static long read_some(int fd, void* dst, size_t n) { return _read(fd, dst, (unsigned)std::min<size_t>(n, 1u << 30)); }
+    static void close_fd(int fd) { _close(fd); }
+
+    static bool is_stream(int fd) {
+        DWORD type = GetFileType((HANDLE)_get_osfhandle(fd));
+        return type == FILE_TYPE_PIPE || type == FILE_TYPE_CHAR;
+    }
+
+    static size_t bytes_waiting(int fd) {
+        DWORD avail = 0;
+        if (!PeekNamedPipe((HANDLE)_get_osfhandle(fd), nullptr, 0, nullptr, &avail, nullptr)) return 0;
+        return avail;
+    }
+#else
+    // the pipe keeps its own descriptor; fd 0 becomes the terminal for ncurses
+    // and poll(), or /dev/null when there is none, so nothing else reads the video
+    static int take_stdin() {
+        int fd = fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 3);
+        if (fd < 0) return -1;
+        int tty = open("/dev/tty", O_RDONLY);
+        if (tty < 0) tty = open("/dev/null", O_RDONLY);
+        if (tty >= 0) {
+            dup2(tty, STDIN_FILENO);
+            close(tty);
+        }
+        return fd;
+    }
+
+    static int open_path(const std::string& path) { return open(path.c_str(), O_RDONLY | O_CLOEXEC); }
+
+    static long read_some(int fd, void* dst, size_t n) {
+        for (;;) {
+            ssize_t got = ::read(fd, dst, n);
+            if (got >= 0 || errno != EINTR) return (long)got;
+        }
+    }
+
+    static void close_fd(int fd) { close(fd); }
+
+    static bool is_stream(int fd) {
+        struct stat st;
+        return fstat(fd, &st) == 0 && (S_ISFIFO(st.st_mode) || S_ISSOCK(st.st_mode) || S_ISCHR(st.st_mode));
+    }
+
+    static size_t bytes_waiting(int fd) {
+        int avail = 0;
+        if (ioctl(fd, FIONREAD, &avail) != 0 || avail < 0) return 0;
+        return (size_t)avail;
+    }
+#endif
+
+    bool RawFrameReader::open(const std::string& path, const RawFormat& fmt) {
+        release();
+        if (!fmt.valid()) return false;
+        fd = path == "-" ? take_stdin() : open_path(path);
+        if (fd < 0) return false;
+        format = fmt;
+        is_live = is_stream(fd);
+        buffer.create(format.size, CV_8UC3);
+        return true;
+    }
+
+    void RawFrameReader::release() {
+        if (fd >= 0) close_fd(fd);
+        fd = -1;
+        is_live = false;
+    }
+
+    // a default pipe (64 KB on Linux) holds less than one frame of most sizes;
+    // small frames or an enlarged pipe can have several waiting
+    size_t RawFrameReader::frames_waiting() const {
+        if (fd < 0 || !is_live) return 0;
+        return bytes_waiting(fd) / format.frame_bytes();
+    }
+
+    // one whole frame into the buffer; a pipe hands it over in pieces
+    bool RawFrameReader::fill() {
+        if (fd < 0) return false;
+        uint8_t* dst = buffer.data;
+        size_t left = format.frame_bytes();
+        while (left > 0) {
+            long got = read_some(fd, dst, left);
+            if (got <= 0) return false;
+            dst += got;
+            left -= (size_t)got;
+        }
+        return true;
+    }
+
+    bool RawFrameReader::read(cv::Mat& frame) {
+        if (!fill()) return false;
+        frame = buffer;
+        return true;
+    }
+
+    bool RawFrameReader::grab() {
+        return fill();
+    }
+}
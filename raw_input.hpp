@@ -0,0 +1,53 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <string>
+
+namespace ascii_render {
+
+    // size and rate of a raw stream, as given by --raw=WxH@FPS
+    struct RawFormat {
+        cv::Size size;
+        double fps = 0.0;
+
+        bool parse(const std::string& spec); // "640x360@30"; the rate may be fractional (29.97)
+        bool valid() const { return size.width > 0 && size.height > 0 && fps > 0.0; }
+        size_t frame_bytes() const { return (size_t)size.width * size.height * 3; }
+    };
+
+    // Headerless BGR24 frames back to back, from stdin ("-"), a FIFO or a
+    // file, e.g. `ffmpeg ... -f rawvideo -pix_fmt bgr24 -`. There is no
+    // container and no decoder: every frame is read straight into one reused
+    // buffer, and the picture goes from there to the resampler and encoder.
+    class RawFrameReader {
+    public:
+        RawFrameReader() = default;
+        ~RawFrameReader() { release(); }
+        RawFrameReader(const RawFrameReader&) = delete;
+        RawFrameReader& operator=(const RawFrameReader&) = delete;
+
+        // Taking "-" moves the stream off stdin and points stdin at the
+        // terminal, so the keys keep working while the video comes down the pipe.
+        bool open(const std::string& path, const RawFormat& format);
+        bool isOpened() const { return fd >= 0; }
+        void release();
+
+        // false at the end of the stream, including a final partial frame;
+        // frame shares the reader's buffer until the next read() or grab()
+        bool read(cv::Mat& frame);
+        bool grab(); // consume a frame without handing it out
+
+        // a pipe, FIFO or terminal: frames arrive at the producer's pace, so
+        // they are shown as they come instead of on the reader's own clock
+        bool live() const { return is_live; }
+        // whole frames already waiting in a live stream; 0 when none or unknown
+        size_t frames_waiting() const;
+
+    private:
+        bool fill();
+
+        int fd = -1;
+        bool is_live = false;
+        RawFormat format;
+        cv::Mat buffer;
+    };
+}
@@ -0,0 +1,67 @@
+#include "renderer.hpp"
+#include "thread_affinity.hpp"
+#include "thread_pool.hpp"
+#include "trace.hpp"
+#include <algorithm>
+
+namespace ascii_render {
+
+    // a pool without workers when threads <= 1: every encode then runs inline
+    Renderer::Renderer(const RendererOptions& opts)
+        : options(opts),
+          pool(std::make_unique<ThreadPool>(opts.threads > 1 ? (size_t)opts.threads : 0,
+                                            [] {
+                                                apply_thread_role(ThreadRole::Encode);
+                                                trace_thread_name("encode worker");
+                                            })),
+          table(opts.palette),
+          video(compositor.add_layer()) {
+        compositor.set_escape_options(options.escapes);
+        compositor.set_colors(&table);
+    }
+
+    Renderer::~Renderer() = default;
+
+    void Renderer::encode(const cv::Mat& frame, CellGrid& out) {
+        frame_to_cells(frame, color_table(), out, *pool, options.threads, options.glyphs);
+    }
+
+    bool Renderer::update(const cv::Mat& frame) {
+        return cache.encode(frame, color_table(), *pool, options.threads, options.glyphs);
+    }
+
+    bool Renderer::repeats(const cv::Mat& frame) {
+        return cache.repeat(frame, options.rgb, options.glyphs);
+    }
+
+    void Renderer::encode_whole(const cv::Mat& frame, CellGrid& out) const {
+        frame_to_cells(frame, color_table(), out, *pool, 1, options.glyphs);
+    }
+
+    void Renderer::show(const CellGrid& cells) {
+        if (cells.width != video.width() || cells.height != video.height()) {
+            video.place(0, 0, cells.width, cells.height);
+            compositor.resize(std::max(compositor.cols(), cells.width), std::max(compositor.rows(), cells.height));
+        }
+        video.assign(cells);
+    }
+
+    size_t Renderer::present(std::string& out) {
+        return compositor.present(out);
+    }
+
+    size_t Renderer::present(const CellGrid& cells, std::string& out) {
+        show(cells);
+        return compositor.present(out);
+    }
+
+    size_t Renderer::render(const cv::Mat& frame, std::string& out) {
+        if (update(frame)) show(cells());
+        return compositor.present(out);
+    }
+
+    // the video layer still holds the last picture, so the cache stays valid
+    void Renderer::invalidate() {
+        compositor.invalidate();
+    }
+}
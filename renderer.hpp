@@ -0,0 +1,77 @@
+#pragma once
+#include "ascii_render.hpp"
+#include "compositor.hpp"
+#include <memory>
+#include <string>
+
+class ThreadPool;
+
+namespace ascii_render {
+
+    struct RendererOptions {
+        int threads = 1;                         // encode workers the renderer owns; 1 encodes on the caller's thread
+        bool rgb = true;                         // false: glyphs only, in the terminal's own color
+        GlyphMode glyphs = GlyphMode::Luminance;
+        Palette palette = Palette::Cube216;
+        EscapeOptions escapes;
+    };
+
+    // Frames in, terminal bytes out, with no process-wide state. The renderer
+    // owns its worker pool, color table, frame cache and the diff state of
+    // its screen, so several can run in one process (or in a test) side by
+    // side. Results go into buffers the caller keeps and reuses.
+    //
+    // The encode calls (encode, update, repeats, encode_whole) and the screen
+    // calls (show, present, invalidate, screen) share nothing but the
+    // read-only color table: one thread may encode while another presents.
+    class Renderer {
+    public:
+        explicit Renderer(const RendererOptions& options = RendererOptions());
+        ~Renderer();
+        Renderer(const Renderer&) = delete;
+        Renderer& operator=(const Renderer&) = delete;
+
+        // a grid-size CV_8UC3 frame into cells, every row encoded
+        void encode(const cv::Mat& frame, CellGrid& out);
+
+        // through the frame cache: only changed rows are encoded into cells();
+        // false when the frame repeats the previous one and cells() still hold it
+        bool update(const cv::Mat& frame);
+        const CellGrid& cells() const { return cache.cells(); }
+
+        // for frames encoded whole on workers() (frame-parallel): the cache's
+        // repeat check alone, and an encode in one block on the calling thread
+        bool repeats(const cv::Mat& frame);
+        void encode_whole(const cv::Mat& frame, CellGrid& out) const;
+        ThreadPool& workers() { return *pool; } // has no workers when options.threads <= 1
+
+        // cells onto the video layer at (0, 0)
+        void show(const CellGrid& cells);
+
+        // appends to out whatever turns the terminal's last picture into the
+        // current layers and returns the number of cells changed
+        size_t present(std::string& out);
+        size_t present(const CellGrid& cells, std::string& out); // show + present
+
+        // encode + present; only changed rows are encoded, a repeated frame leaves the video as is
+        size_t render(const cv::Mat& frame, std::string& out);
+
+        void invalidate(); // the terminal was cleared: the next present redraws everything
+
+        // for more layers (status, overlays); grows to hold the video, never shrinks by itself
+        Compositor& screen() { return compositor; }
+        cv::Size video_size() const { return cv::Size(video.width(), video.height()); }
+        const ColorTable& colors() const { return table; }
+        const FrameCache::Stats& cache_stats() const { return cache.stats(); }
+
+    private:
+        const ColorTable* color_table() const { return options.rgb ? &table : nullptr; } // nullptr: glyphs only
+
+        RendererOptions options;
+        std::unique_ptr<ThreadPool> pool;
+        ColorTable table;
+        FrameCache cache;
+        Compositor compositor;
+        Layer& video;
+    };
+}
@@ -0,0 +1,48 @@
+#include "resample.hpp"
+#include <algorithm>
+
+namespace ascii_render {
+
+    ResampleCache::ResampleCache(size_t capacity) : capacity(std::max<size_t>(1, capacity)) {}
+
+    void ResampleCache::clear() {
+        entries.clear();
+    }
+
+    const ResampleCache::Entry& ResampleCache::lookup(cv::Size src, cv::Size dst) {
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            if (it->src == src && it->dst == dst) {
+                if (it != entries.begin()) entries.splice(entries.begin(), entries, it);
+                return entries.front();
+            }
+        }
+
+        // same sample positions as cv::resize(INTER_LINEAR): pixel centers aligned
+        cv::Mat map_x(dst, CV_32FC1), map_y(dst, CV_32FC1);
+        const float sx = (float)src.width / dst.width;
+        const float sy = (float)src.height / dst.height;
+        for (int y = 0; y < dst.height; ++y) {
+            float fy = std::max(0.0f, (y + 0.5f) * sy - 0.5f);
+            float* mx = map_x.ptr<float>(y);
+            float* my = map_y.ptr<float>(y);
+            for (int x = 0; x < dst.width; ++x) {
+                mx[x] = std::max(0.0f, (x + 0.5f) * sx - 0.5f);
+                my[x] = fy;
+            }
+        }
+
+        Entry e;
+        e.src = src;
+        e.dst = dst;
+        cv::convertMaps(map_x, map_y, e.map1, e.map2, CV_16SC2);
+
+        entries.push_front(std::move(e));
+        if (entries.size() > capacity) entries.pop_back();
+        return entries.front();
+    }
+
+    void ResampleCache::resample(const cv::Mat& src, cv::Mat& dst, cv::Size grid) {
+        const Entry& e = lookup(src.size(), grid);
+        cv::remap(src, dst, e.map1, e.map2, cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <list>
+
+namespace ascii_render {
+
+    // Downscales frames to the character grid with cv::remap. The fixed-point
+    // sample maps are built once per (source size, grid size) pair and kept,
+    // so a terminal resize costs one map build and every later frame at that
+    // size reuses the cached tables.
+    class ResampleCache {
+    public:
+        explicit ResampleCache(size_t capacity = 4);
+
+        void resample(const cv::Mat& src, cv::Mat& dst, cv::Size grid);
+        void clear();
+
+    private:
+        struct Entry {
+            cv::Size src;
+            cv::Size dst;
+            cv::Mat map1; // CV_16SC2 integer sample coordinates
+            cv::Mat map2; // CV_16UC1 interpolation weights
+        };
+
+        const Entry& lookup(cv::Size src, cv::Size dst);
+
+        std::list<Entry> entries; // most recently used first
+        size_t capacity;
+    };
+}
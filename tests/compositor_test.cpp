@@ -0,0 +1,281 @@
+// Replays layered frames through the compositor and feeds its output to a
+// model of the terminal (cursor, pen, pending wrap, REP). After every
+// present() the modelled screen has to match the composed layers cell for
+// cell, for every combination of escape forms.
+#include "compositor.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace ascii_render;
+
+namespace {
+
+    // the subset of a VT100/xterm the compositor may write
+    struct Terminal {
+        int width = 0, height = 0;
+        std::vector<char> glyphs;
+        std::vector<uint16_t> colors;
+        int x = 0, y = 0;
+        bool pending_wrap = false; // printed into the last column
+        uint16_t pen = DEFAULT_COLOR;
+        char last = ' ';
+        size_t reps = 0;
+        std::map<std::string, uint16_t> sgr; // foreground sequence -> palette index
+        std::string error;
+
+        explicit Terminal(const ColorTable& table) {
+            for (uint16_t c = 0; c < 216; ++c) sgr[std::string(table.sequence(c))] = c;
+            sgr[std::string(table.sequence(DEFAULT_COLOR))] = DEFAULT_COLOR;
+        }
+
+        // contents the compositor can't know: after a resize or a clear
+        void scramble(int w, int h) {
+            width = w;
+            height = h;
+            glyphs.assign((size_t)w * h, '?');
+            colors.assign((size_t)w * h, 7);
+            pending_wrap = false;
+        }
+
+        void print(char ch) {
+            if (pending_wrap) {
+                x = 0;
+                if (++y >= height) { error = "wrapped past the last row"; y = height - 1; }
+                pending_wrap = false;
+            }
+            glyphs[(size_t)y * width + x] = ch;
+            colors[(size_t)y * width + x] = pen;
+            last = ch;
+            if (x == width - 1) pending_wrap = true;
+            else ++x;
+        }
+
+        void move(int row, int col) {
+            y = std::max(0, std::min(height - 1, row));
+            x = std::max(0, std::min(width - 1, col));
+            pending_wrap = false;
+        }
+
+        void csi(const std::string& seq, const std::string& params, char final) {
+            int n = params.empty() ? 1 : std::atoi(params.c_str());
+            switch (final) {
+            case 'H': {
+                size_t semi = params.find(';');
+                int row = params.empty() ? 1 : std::atoi(params.c_str());
+                int col = semi == std::string::npos ? 1 : std::atoi(params.c_str() + semi + 1);
+                move(row - 1, col - 1);
+                break;
+            }
+            case 'A': move(y - n, x); break;
+            case 'B': move(y + n, x); break;
+            case 'C': move(y, x + n); break;
+            case 'D': move(y, x - n); break;
+            case 'E': move(y + n, 0); break;
+            case 'b':
+                ++reps;
+                for (int i = 0; i < n; ++i) print(last);
+                break;
+            case 'm':
+                if (params == "0") pen = DEFAULT_COLOR;
+                else if (params.rfind("48;", 0) == 0) {} // background, fixed
+                else if (sgr.count(seq)) pen = sgr[seq];
+                else error = "unknown SGR " + params;
+                break;
+            default:
+                error = std::string("unexpected CSI final '") + final + "'";
+            }
+        }
+
+        void feed(const std::string& out) {
+            for (size_t i = 0; i < out.size() && error.empty(); ++i) {
+                char ch = out[i];
+                if (ch == '\r') {
+                    x = 0;
+                    pending_wrap = false;
+                } else if (ch == '\x1b') {
+                    if (i + 1 >= out.size() || out[i + 1] != '[') { error = "ESC without CSI"; return; }
+                    size_t j = i + 2;
+                    while (j < out.size() && (std::isdigit((unsigned char)out[j]) || out[j] == ';')) ++j;
+                    if (j >= out.size()) { error = "truncated CSI"; return; }
+                    csi(out.substr(i, j - i + 1), out.substr(i + 2, j - i - 2), out[j]);
+                    i = j;
+                } else if ((unsigned char)ch < 0x20 || ch == TRANSPARENT) {
+                    error = "control character in output";
+                } else {
+                    print(ch);
+                }
+            }
+        }
+    };
+
+    struct Placed {
+        CellGrid cells;
+        int top = 0, left = 0;
+        bool visible = true;
+    };
+
+    // what the screen should show: layers bottom to top, like Compositor::compose_row
+    void compose(const std::vector<const Placed*>& layers, int w, int h, CellGrid& out) {
+        out.resize(w, h);
+        for (const Placed* l : layers) {
+            if (!l->visible) continue;
+            for (int ly = 0; ly < l->cells.height; ++ly) {
+                int y = l->top + ly;
+                if (y < 0 || y >= h) continue;
+                for (int lx = 0; lx < l->cells.width; ++lx) {
+                    int x = l->left + lx;
+                    if (x < 0 || x >= w) continue;
+                    char ch = l->cells.glyph_row(ly)[lx];
+                    if (ch == TRANSPARENT) continue;
+                    out.glyph_row(y)[x] = ch;
+                    out.color_row(y)[x] = ch == ' ' ? DEFAULT_COLOR : l->cells.color_row(ly)[lx];
+                }
+            }
+        }
+    }
+
+    // runs of one glyph and color, as video cells tend to have
+    void paint_runs(CellGrid& g, std::mt19937& rng, double share) {
+        static const char RAMP[] = " .:-=+*#%@";
+        std::uniform_real_distribution<double> coin(0.0, 1.0);
+        for (int y = 0; y < g.height; ++y) {
+            for (int x = 0; x < g.width;) {
+                int run = 1 + (int)(rng() % 12);
+                if (coin(rng) < share) {
+                    char ch = RAMP[rng() % (sizeof(RAMP) - 1)];
+                    uint16_t color = rng() % 5 == 0 ? DEFAULT_COLOR : (uint16_t)(rng() % 6 * 36);
+                    for (int i = x; i < std::min(g.width, x + run); ++i) {
+                        g.glyph_row(y)[i] = ch;
+                        g.color_row(y)[i] = color;
+                    }
+                }
+                x += run;
+            }
+        }
+    }
+
+    int check(const char* name, const EscapeOptions& escapes, const ColorTable& table) {
+        std::mt19937 rng(1234);
+        Compositor screen;
+        screen.set_colors(&table);
+        screen.set_escape_options(escapes);
+        Layer& video = screen.add_layer();
+        Layer& status = screen.add_layer();
+        Layer& hud = screen.add_layer();
+        Placed v, s, h;
+        std::vector<const Placed*> stack{&v, &s, &h};
+
+        Terminal term(table);
+        CellGrid expected;
+        std::string out;
+        int cols = 0, rows = 0;
+        const int FRAMES = 400;
+
+        for (int frame = 0; frame < FRAMES; ++frame) {
+            if (frame % 80 == 0) {
+                cols = 20 + (int)(rng() % 50);
+                rows = 6 + (int)(rng() % 16);
+                screen.resize(cols, rows);
+                term.scramble(cols, rows);
+                const int hud_w = std::min(16, cols);
+                video.place(0, 0, cols, rows - 2);
+                status.place(rows - 2, 0, cols, 2);
+                hud.place(0, cols - hud_w, hud_w, 1);
+                v.cells.resize(cols, rows - 2);
+                s.cells.resize(cols, 2);
+                h.cells.resize(hud_w, 1);
+                v.top = 0; s.top = rows - 2; h.top = 0; h.left = cols - hud_w;
+                paint_runs(v.cells, rng, 1.0);
+            } else if (frame % 37 == 0) {
+                screen.invalidate(); // e.g. the terminal was cleared behind our back
+                term.scramble(cols, rows);
+            }
+
+            // scene cuts, small changes and repeated frames
+            int kind = frame % 10;
+            if (kind == 0) paint_runs(v.cells, rng, 1.0);
+            else if (kind < 8) paint_runs(v.cells, rng, 0.08);
+            video.assign(v.cells);
+
+            char text[64];
+            int len = std::snprintf(text, sizeof(text), "frame %d  |>", frame);
+            s.cells.fill(' ', DEFAULT_COLOR);
+            for (int i = 0; i < len && i < cols; ++i) {
+                s.cells.glyph_row(1)[i] = text[i];
+                s.cells.color_row(1)[i] = WHITE;
+            }
+            status.assign(s.cells);
+
+            // HUD text over the video, transparent left of it
+            h.cells.fill(TRANSPARENT, DEFAULT_COLOR);
+            len = std::snprintf(text, sizeof(text), "%d fps", 50 + frame % 13);
+            for (int i = 0, x0 = std::max(0, h.cells.width - len); i < len && x0 + i < h.cells.width; ++i) {
+                h.cells.glyph_row(0)[x0 + i] = text[i];
+                h.cells.color_row(0)[x0 + i] = WHITE;
+            }
+            hud.assign(h.cells);
+            if (frame % 23 == 0) {
+                h.visible = !h.visible;
+                hud.set_visible(h.visible);
+            }
+
+            out.clear();
+            screen.present(out);
+            // input handling moves the cursor between frames: the compositor must not rely on it
+            term.feed(out);
+            term.move((int)(rng() % rows), (int)(rng() % cols));
+            if (!term.error.empty()) {
+                std::printf("%s: frame %d: %s\n", name, frame, term.error.c_str());
+                return 1;
+            }
+
+            compose(stack, cols, rows, expected);
+            for (int y = 0; y < rows; ++y) {
+                for (int x = 0; x < cols; ++x) {
+                    char want = expected.glyph_row(y)[x];
+                    char got = term.glyphs[(size_t)y * cols + x];
+                    uint16_t want_color = expected.color_row(y)[x];
+                    uint16_t got_color = term.colors[(size_t)y * cols + x];
+                    // a space looks the same in any foreground
+                    if (want != got || (want != ' ' && want_color != got_color)) {
+                        std::printf("%s: frame %d: cell (%d, %d) is '%c'/%d, expected '%c'/%d\n",
+                                    name, frame, y, x, got, got_color, want, want_color);
+                        return 1;
+                    }
+                }
+            }
+        }
+
+        if (escapes.rep != (term.reps > 0)) {
+            std::printf("%s: %zu REP sequences written\n", name, term.reps);
+            return 1;
+        }
+        std::printf("%s: %d frames match\n", name, FRAMES);
+        return 0;
+    }
+}
+
+int main() {
+    const ColorTable table(Palette::Cube216);
+
+    EscapeOptions absolute;
+    absolute.relative_moves = absolute.rewrite_gaps = false;
+    EscapeOptions relative;
+    relative.rewrite_gaps = false;
+    EscapeOptions shortest;
+    EscapeOptions with_rep;
+    with_rep.rep = true;
+
+    int failed = 0;
+    failed += check("absolute moves", absolute, table);
+    failed += check("relative moves", relative, table);
+    failed += check("shortest form", shortest, table);
+    failed += check("shortest + REP", with_rep, table);
+    return failed ? 1 : 0;
+}
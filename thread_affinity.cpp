@@ -0,0 +1,246 @@
+#include "thread_affinity.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#ifdef _WIN32
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <pthread.h>
+    #include <sched.h>
+    #include <sys/resource.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+namespace ascii_render {
+
+    namespace {
+        std::mutex placement_mutex;
+        ThreadPlacement placement;
+        std::atomic<int> refused[(int)ThreadRole::Count];
+
+        // the CPUs this process may run on: ids can have gaps (offline CPUs,
+        // cpusets, taskset), so they are read from the OS, not counted
+        std::vector<int> all_cpus() {
+            std::vector<int> cpus;
+#ifdef _WIN32
+            DWORD_PTR process_mask = 0, system_mask = 0;
+            if (GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask)) {
+                for (int b = 0; b < (int)sizeof(DWORD_PTR) * 8; ++b)
+                    if (process_mask & ((DWORD_PTR)1 << b)) cpus.push_back(b);
+            }
+#else
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+                for (int c = 0; c < CPU_SETSIZE; ++c)
+                    if (CPU_ISSET(c, &set)) cpus.push_back(c);
+            }
+            if (cpus.empty()) {
+                std::ifstream online("/sys/devices/system/cpu/online");
+                std::string list;
+                if (online >> list) parse_cpu_list(list, cpus);
+            }
+#endif
+            if (cpus.empty()) {
+                cpus.resize(std::max(1u, std::thread::hardware_concurrency()));
+                for (size_t i = 0; i < cpus.size(); ++i) cpus[i] = (int)i;
+            }
+            return cpus;
+        }
+
+        // drops the CPUs outside `allowed` (both sorted)
+        std::vector<int> intersect(const std::vector<int>& cpus, const std::vector<int>& allowed) {
+            std::vector<int> out;
+            std::set_intersection(cpus.begin(), cpus.end(), allowed.begin(), allowed.end(), std::back_inserter(out));
+            return out;
+        }
+
+        std::string format_cpu_list(const std::vector<int>& cpus) {
+            std::string out;
+            for (size_t i = 0; i < cpus.size();) {
+                size_t j = i;
+                while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) ++j;
+                if (!out.empty()) out += ',';
+                out += std::to_string(cpus[i]);
+                if (j > i) out += '-' + std::to_string(cpus[j]);
+                i = j + 1;
+            }
+            return out;
+        }
+    }
+
+    bool parse_cpu_list(const std::string& text, std::vector<int>& cpus) {
+        std::set<int> set;
+        size_t pos = 0;
+        while (pos < text.size()) {
+            size_t end = text.find(',', pos);
+            if (end == std::string::npos) end = text.size();
+            std::string part = text.substr(pos, end - pos);
+            size_t dash = part.find('-');
+            char* rest = nullptr;
+            long lo = std::strtol(part.c_str(), &rest, 10);
+            long hi = lo;
+            if (rest == part.c_str()) return false;
+            if (dash != std::string::npos) {
+                if (rest != part.c_str() + dash) return false;
+                const char* hs = part.c_str() + dash + 1;
+                hi = std::strtol(hs, &rest, 10);
+                if (rest == hs) return false;
+            }
+            if (*rest != '\0' || lo < 0 || hi < lo || hi > 4095) return false;
+            for (long c = lo; c <= hi; ++c) set.insert((int)c);
+            pos = end + 1;
+        }
+        cpus.assign(set.begin(), set.end());
+        return !cpus.empty();
+    }
+
+    std::vector<std::vector<int>> cache_domains() {
+        const std::vector<int> allowed = all_cpus();
+        std::vector<std::vector<int>> domains;
+#ifdef _WIN32
+        DWORD len = 0;
+        GetLogicalProcessorInformation(nullptr, &len);
+        std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info(len / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+        if (!info.empty() && GetLogicalProcessorInformation(info.data(), &len)) {
+            int top = 0;
+            for (auto& i : info)
+                if (i.Relationship == RelationCache) top = std::max<int>(top, i.Cache.Level);
+            for (auto& i : info) {
+                if (i.Relationship != RelationCache || i.Cache.Level != top) continue;
+                std::vector<int> cpus;
+                for (int b = 0; b < (int)sizeof(ULONG_PTR) * 8; ++b)
+                    if (i.ProcessorMask & ((ULONG_PTR)1 << b)) cpus.push_back(b);
+                cpus = intersect(cpus, allowed);
+                if (!cpus.empty() && std::find(domains.begin(), domains.end(), cpus) == domains.end())
+                    domains.push_back(cpus);
+            }
+        }
+#else
+        // per CPU, the highest cache level listed in sysfs and the CPUs sharing it
+        for (int cpu : allowed) {
+            int top = -1;
+            std::vector<int> shared;
+            for (int index = 0; index < 10; ++index) {
+                std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cache/index" + std::to_string(index) + "/";
+                std::ifstream level_file(dir + "level"), list_file(dir + "shared_cpu_list");
+                int level;
+                std::string list;
+                if (!(level_file >> level) || !(list_file >> list)) break;
+                std::vector<int> cpus;
+                if (level > top && parse_cpu_list(list, cpus)) {
+                    top = level;
+                    shared = cpus;
+                }
+            }
+            shared = intersect(shared, allowed);
+            if (!shared.empty() && std::find(domains.begin(), domains.end(), shared) == domains.end())
+                domains.push_back(shared);
+        }
+#endif
+        if (domains.empty()) domains.push_back(allowed);
+        std::stable_sort(domains.begin(), domains.end(),
+                         [](const std::vector<int>& a, const std::vector<int>& b) { return a.size() > b.size(); });
+        return domains;
+    }
+
+    ThreadPlacement default_placement() {
+        ThreadPlacement p;
+        auto domains = cache_domains();
+        if (domains.size() < 2) return p;
+
+        p[ThreadRole::Encode].cpus = domains[0];
+        std::vector<int> rest;
+        for (size_t i = 1; i < domains.size(); ++i) rest.insert(rest.end(), domains[i].begin(), domains[i].end());
+        std::sort(rest.begin(), rest.end());
+        p[ThreadRole::Decode].cpus = rest;
+        return p;
+    }
+
+    const char* role_name(ThreadRole role) {
+        switch (role) {
+        case ThreadRole::Decode: return "decode";
+        case ThreadRole::Encode: return "encode";
+        case ThreadRole::Writer: return "writer";
+        case ThreadRole::Input: return "input";
+        default: return "?";
+        }
+    }
+
+    bool parse_role(const std::string& name, ThreadRole& role) {
+        for (int r = 0; r < (int)ThreadRole::Count; ++r) {
+            if (name == role_name((ThreadRole)r)) {
+                role = (ThreadRole)r;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void set_thread_placement(const ThreadPlacement& p) {
+        std::lock_guard<std::mutex> lock(placement_mutex);
+        placement = p;
+    }
+
+    bool apply_thread_role(ThreadRole role) {
+        RolePolicy policy;
+        {
+            std::lock_guard<std::mutex> lock(placement_mutex);
+            policy = placement[role];
+        }
+        bool ok = true;
+#ifdef _WIN32
+        if (!policy.cpus.empty()) {
+            DWORD_PTR mask = 0;
+            for (int c : policy.cpus)
+                if (c < (int)sizeof(DWORD_PTR) * 8) mask |= (DWORD_PTR)1 << c;
+            ok = mask && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+        }
+        if (policy.set_nice) {
+            // nice scale onto the Win32 thread priority levels
+            int prio = policy.nice <= -10 ? THREAD_PRIORITY_HIGHEST
+                     : policy.nice < 0    ? THREAD_PRIORITY_ABOVE_NORMAL
+                     : policy.nice == 0   ? THREAD_PRIORITY_NORMAL
+                     : policy.nice < 10   ? THREAD_PRIORITY_BELOW_NORMAL
+                                          : THREAD_PRIORITY_LOWEST;
+            ok = SetThreadPriority(GetCurrentThread(), prio) && ok;
+        }
+#else
+        if (!policy.cpus.empty()) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (int c : policy.cpus)
+                if (c < CPU_SETSIZE) CPU_SET(c, &set);
+            ok = pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+        }
+        if (policy.set_nice) {
+            // on Linux the nice value is per thread when addressed by its tid
+            pid_t tid = (pid_t)syscall(SYS_gettid);
+            ok = setpriority(PRIO_PROCESS, (id_t)tid, policy.nice) == 0 && ok;
+        }
+#endif
+        if (!ok) ++refused[(int)role];
+        return ok;
+    }
+
+    void print_thread_placement(std::ostream& os) {
+        std::lock_guard<std::mutex> lock(placement_mutex);
+        for (int r = 0; r < (int)ThreadRole::Count; ++r) {
+            const RolePolicy& p = placement.roles[r];
+            if (p.cpus.empty() && !p.set_nice) continue;
+            os << "threads: " << role_name((ThreadRole)r) << " on cpus "
+               << (p.cpus.empty() ? std::string("any") : format_cpu_list(p.cpus));
+            if (p.set_nice) os << ", nice " << p.nice;
+            if (int n = refused[r].load()) os << " (refused for " << n << " threads)";
+            os << "\n";
+        }
+    }
+}
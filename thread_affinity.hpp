@@ -0,0 +1,44 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ascii_render {
+
+    // pipeline roles that get their own CPU set and priority
+    enum class ThreadRole { Decode, Encode, Writer, Input, Count };
+
+    struct RolePolicy {
+        std::vector<int> cpus; // empty: may run on any CPU
+        bool set_nice = false;
+        int nice = 0;          // -20 (most favoured) .. 19, the nice(1) scale on every platform
+    };
+
+    struct ThreadPlacement {
+        RolePolicy roles[(int)ThreadRole::Count];
+
+        RolePolicy& operator[](ThreadRole r) { return roles[(int)r]; }
+        const RolePolicy& operator[](ThreadRole r) const { return roles[(int)r]; }
+    };
+
+    // CPUs the process may use, grouped by the last-level cache they share, largest group first
+    std::vector<std::vector<int>> cache_domains();
+
+    // encode workers share one cache domain; decode goes to the other CPUs
+    // when there are any. One domain (or an unknown topology) pins nothing.
+    ThreadPlacement default_placement();
+
+    const char* role_name(ThreadRole role);
+    bool parse_role(const std::string& name, ThreadRole& role);
+    bool parse_cpu_list(const std::string& text, std::vector<int>& cpus); // "0-3,6"
+
+    // process-wide; set before the threads it applies to are started
+    void set_thread_placement(const ThreadPlacement& placement);
+
+    // moves the calling thread to its role's CPUs and priority; false when
+    // the OS refused part of it (e.g. a negative nice without privileges)
+    bool apply_thread_role(ThreadRole role);
+
+    // the placement in effect and how many threads it was refused for
+    void print_thread_placement(std::ostream& os);
+}
@@ -0,0 +1,165 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+#include <thread>
+#include <queue>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+class ThreadPool {
+public:
+    // on_start runs first on every worker thread (CPU placement, priority)
+    ThreadPool(size_t num_threads, std::function<void()> on_start = nullptr) : stop_flag(false) {
+        for (size_t i = 0; i < num_threads; ++i) {
+            workers.emplace_back([this, on_start] {
+                if (on_start) on_start();
+                for (;;) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lock(this->mtx);
+                        cv_task.wait(lock, [this] {
+                            return this->stop_flag || !this->tasks.empty();
+                        });
+                        if (this->stop_flag && this->tasks.empty()) return;
+                        task = std::move(this->tasks.front());
+                        this->tasks.pop();
+                    }
+                    task();
+                }
+            });
+        }
+    }
+    ~ThreadPool() {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            stop_flag = true;
+        }
+        cv_task.notify_all();
+        for (auto &t : workers) t.join();
+    }
+    void enqueue(std::function<void()> f) {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            tasks.push(std::move(f));
+        }
+        cv_task.notify_one();
+    }
+    size_t size() const {
+        return workers.size();
+    }
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mtx;
+    std::condition_variable cv_task;
+    std::atomic<bool> stop_flag;
+};
+
+// The tasks of one caller, and a wait for just those: other callers' work on
+// the same pool never holds it up. wait() runs the batch's not yet started
+// tasks itself, so a pool worker can wait on a batch without deadlocking the pool.
+class TaskBatch {
+public:
+    explicit TaskBatch(ThreadPool& pool) : pool(pool), state(std::make_shared<State>()) {}
+    ~TaskBatch() { wait(); }
+    TaskBatch(const TaskBatch&) = delete;
+    TaskBatch& operator=(const TaskBatch&) = delete;
+
+    void run(std::function<void()> f) {
+        {
+            std::lock_guard<std::mutex> lock(state->mtx);
+            state->tasks.push_back(std::move(f));
+            ++state->pending;
+        }
+        // the pool task may find the batch already done by wait(); it keeps the state alive
+        pool.enqueue([s = state] { s->run_one(); });
+    }
+
+    void wait() {
+        while (state->run_one()) {}
+        std::unique_lock<std::mutex> lock(state->mtx);
+        state->cv_done.wait(lock, [this] { return state->pending == 0; });
+    }
+
+private:
+    struct State {
+        std::mutex mtx;
+        std::condition_variable cv_done;
+        std::deque<std::function<void()>> tasks; // not started yet
+        int pending = 0;                         // not finished yet
+
+        bool run_one() {
+            std::function<void()> f;
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (tasks.empty()) return false;
+                f = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            f();
+            std::lock_guard<std::mutex> lock(mtx);
+            if (--pending == 0) cv_done.notify_all();
+            return true;
+        }
+    };
+
+    ThreadPool& pool;
+    std::shared_ptr<State> state;
+};
+
+// Runs body(i) for every i in [0, n) on the calling thread and up to n - 1
+// pool tasks, which claim indices from one counter. Per call there is one
+// allocation and no std::function that owns state, so frame encoders can use
+// it for every frame. It returns once every index is done and does not wait
+// for helper tasks still queued behind other work: those find nothing left
+// to do, and only they keep the shared counter alive.
+template <class Body>
+void parallel_for(ThreadPool& pool, int n, const Body& body) {
+    const int helpers = std::min(n - 1, (int)pool.size());
+    if (helpers <= 0) {
+        for (int i = 0; i < n; ++i) body(i);
+        return;
+    }
+
+    struct Shared {
+        std::atomic<int> next{0};
+        std::atomic<int> refs{0};
+        int n = 0;
+        const void* body = nullptr;
+        void (*call)(const void*, int) = nullptr;
+        std::mutex mtx;
+        std::condition_variable cv_done;
+        int done = 0; // guarded by mtx
+
+        void work() {
+            int ran = 0;
+            for (int i; (i = next.fetch_add(1)) < n; ++ran) call(body, i);
+            if (ran == 0) return;
+            std::lock_guard<std::mutex> lock(mtx);
+            done += ran;
+            if (done == n) cv_done.notify_all();
+        }
+        void release() {
+            if (refs.fetch_sub(1) == 1) delete this;
+        }
+    };
+
+    Shared* shared = new Shared;
+    shared->refs.store(helpers + 1);
+    shared->n = n;
+    shared->body = &body;
+    shared->call = [](const void* b, int i) { (*static_cast<const Body*>(b))(i); };
+    // a bare pointer fits in std::function's own storage: enqueue allocates nothing for it
+    for (int t = 0; t < helpers; ++t) pool.enqueue([shared] { shared->work(); shared->release(); });
+
+    shared->work();
+    {
+        std::unique_lock<std::mutex> lock(shared->mtx);
+        shared->cv_done.wait(lock, [shared] { return shared->done == shared->n; });
+    }
+    shared->release();
+}
@@ -0,0 +1,155 @@
+#include "trace.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace ascii_render {
+
+    namespace {
+        struct Event {
+            const char* name;
+            uint64_t begin_ns;
+            uint64_t end_ns; // == begin_ns for instants
+            int64_t arg;
+        };
+
+        // fixed-size block of events; the owning thread is the only writer and
+        // publishes with count, readers walk the chain up to count
+        struct Chunk {
+            static constexpr size_t CAPACITY = 4096;
+            Event events[CAPACITY];
+            std::atomic<size_t> count{0};
+            std::atomic<Chunk*> next{nullptr};
+        };
+
+        struct ThreadBuffer {
+            int tid = 0;
+            std::atomic<const char*> name{nullptr};
+            std::atomic<Chunk*> head{nullptr}; // the first event allocates it
+            Chunk* tail = nullptr;             // writer side only
+
+            ~ThreadBuffer() {
+                for (Chunk* c = head.load(); c;) {
+                    Chunk* next = c->next.load();
+                    delete c;
+                    c = next;
+                }
+            }
+        };
+
+        std::atomic<bool> enabled{false};
+        const auto origin = std::chrono::steady_clock::now();
+
+        // Buffers outlive their threads: the trace is written after they exit.
+        // An exiting thread hands its events to `finished`, which the next
+        // write empties, so buffers of per-item threads don't pile up.
+        std::mutex registry_mutex;
+        std::vector<ThreadBuffer*> running;                  // threads still alive
+        std::vector<std::unique_ptr<ThreadBuffer>> finished; // exited, not written yet
+        int next_tid = 1;
+
+        struct LocalBuffer {
+            std::unique_ptr<ThreadBuffer> buffer = std::make_unique<ThreadBuffer>();
+
+            LocalBuffer() {
+                std::lock_guard<std::mutex> lock(registry_mutex);
+                buffer->tid = next_tid++;
+                running.push_back(buffer.get());
+            }
+            ~LocalBuffer() {
+                std::lock_guard<std::mutex> lock(registry_mutex);
+                running.erase(std::find(running.begin(), running.end(), buffer.get()));
+                if (buffer->head.load()) finished.push_back(std::move(buffer)); // nothing recorded: freed here
+            }
+        };
+
+        ThreadBuffer& local_buffer() {
+            thread_local LocalBuffer local;
+            return *local.buffer;
+        }
+
+        void append(const Event& e) {
+            ThreadBuffer& b = local_buffer();
+            Chunk* c = b.tail;
+            size_t n = c ? c->count.load(std::memory_order_relaxed) : 0;
+            if (!c || n == Chunk::CAPACITY) {
+                Chunk* fresh = new Chunk(); // freed once written after the thread exits
+                if (c) c->next.store(fresh, std::memory_order_release);
+                else b.head.store(fresh, std::memory_order_release);
+                b.tail = c = fresh;
+                n = 0;
+            }
+            c->events[n] = e;
+            c->count.store(n + 1, std::memory_order_release);
+        }
+
+        void put_event(std::FILE* f, bool& first, const Event& e, int tid) {
+            std::fprintf(f, "%s\n{\"name\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f", first ? "" : ",",
+                         e.name, tid, e.begin_ns / 1000.0);
+            if (e.end_ns == e.begin_ns) std::fprintf(f, ",\"ph\":\"i\",\"s\":\"t\"");
+            else std::fprintf(f, ",\"ph\":\"X\",\"dur\":%.3f", (e.end_ns - e.begin_ns) / 1000.0);
+            if (e.arg >= 0) std::fprintf(f, ",\"args\":{\"n\":%lld}", (long long)e.arg);
+            std::fputc('}', f);
+            first = false;
+        }
+    }
+
+    void trace_enable() {
+        enabled.store(true);
+    }
+
+    bool trace_enabled() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    uint64_t trace_now_ns() {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - origin).count();
+    }
+
+    void trace_record(const char* name, uint64_t begin_ns, uint64_t end_ns, int64_t arg) {
+        // a zero-length span would read as an instant
+        append(Event{name, begin_ns, end_ns > begin_ns ? end_ns : begin_ns + 1, arg});
+    }
+
+    void trace_instant(const char* name, int64_t arg) {
+        if (!trace_enabled()) return;
+        uint64_t now = trace_now_ns();
+        append(Event{name, now, now, arg});
+    }
+
+    void trace_thread_name(const char* name) {
+        if (!trace_enabled()) return;
+        local_buffer().name.store(name);
+    }
+
+    bool write_chrome_trace(const std::string& path) {
+        std::FILE* f = std::fopen(path.c_str(), "w");
+        if (!f) return false;
+        std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", f);
+        bool first = true;
+
+        auto put_thread = [&](const ThreadBuffer& b) {
+            if (const char* name = b.name.load()) {
+                std::fprintf(f, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                             first ? "" : ",", b.tid, name);
+                first = false;
+            }
+            for (const Chunk* c = b.head.load(std::memory_order_acquire); c; c = c->next.load(std::memory_order_acquire)) {
+                size_t n = c->count.load(std::memory_order_acquire);
+                for (size_t i = 0; i < n; ++i) put_event(f, first, c->events[i], b.tid);
+            }
+        };
+
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        for (auto& b : finished) put_thread(*b);
+        finished.clear();
+        for (const ThreadBuffer* b : running) put_thread(*b);
+        std::fputs("\n]}\n", f);
+        return std::fclose(f) == 0;
+    }
+}
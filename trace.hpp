@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace ascii_render {
+
+    // Opt-in span tracing. Each thread appends to its own buffer without
+    // locks; write_chrome_trace() turns all buffers into a Chrome trace
+    // (JSON) for chrome://tracing or ui.perfetto.dev. When tracing is off a
+    // span costs one flag check.
+    void trace_enable();
+    bool trace_enabled();
+
+    // label of the calling thread in the trace viewer
+    void trace_thread_name(const char* name);
+
+    // names must be string literals (stored by pointer); arg < 0 means none
+    void trace_instant(const char* name, int64_t arg = -1);
+
+    // spans recorded so far; call once the traced threads are done. Spans of
+    // threads that have exited are freed once written.
+    bool write_chrome_trace(const std::string& path);
+
+    uint64_t trace_now_ns();
+    void trace_record(const char* name, uint64_t begin_ns, uint64_t end_ns, int64_t arg);
+
+    // records [construction, destruction) on the calling thread
+    class TraceSpan {
+    public:
+        explicit TraceSpan(const char* name, int64_t arg = -1)
+            : name(trace_enabled() ? name : nullptr), arg(arg), begin(this->name ? trace_now_ns() : 0) {}
+        ~TraceSpan() {
+            if (name) trace_record(name, begin, trace_now_ns(), arg);
+        }
+        TraceSpan(const TraceSpan&) = delete;
+        TraceSpan& operator=(const TraceSpan&) = delete;
+
+        void set_arg(int64_t value) { arg = value; }
+
+    private:
+        const char* name;
+        int64_t arg;
+        uint64_t begin;
+    };
+}